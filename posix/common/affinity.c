@@ -0,0 +1,338 @@
+/*
+    affinity.c
+    Copyright (C) 2010 Dalmo Cirne
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#define _GNU_SOURCE
+#include <stdlib.h>
+#include <string.h>
+#include <sched.h>
+#include <dirent.h>
+#include <sys/mman.h>
+#include "affinity.h"
+
+#define TOPOLOGY_PATH "/sys/devices/system/cpu/cpu%d/%s"
+
+// Position of a processor in the machine, as reported by the kernel
+typedef struct {
+	int cpu, package, core, node;
+	int sibling; // Rank among the hardware threads of its core
+	int coreRank; // Rank of its core inside its package
+} ProcessorInfo;
+
+static PlacementPolicy placementPolicy = PLACEMENT_NONE;
+static ProcessorInfo *processors; // Allowed processors, in placement order
+static int numberOfProcessors, numberOfPackages, numberOfCores, numberOfNodes;
+static int *nodes; // NUMA nodes that have allowed processors, in ascending order
+static int selectedNode = -1;
+
+#ifdef __linux__
+
+// Reads a number from the topology of a processor. Returns "fallback" if the kernel does not report it
+static int readTopologyValue(int cpu, const char *name, int fallback) {
+	char path[128];
+	FILE *fp;
+	int value;
+	
+	snprintf(path, sizeof(path), TOPOLOGY_PATH, cpu, name);
+	fp = fopen(path, "r");
+	if (fp == NULL) {
+		return fallback;
+	}
+	if (fscanf(fp, "%d", &value) != 1) {
+		value = fallback;
+	}
+	fclose(fp);
+	
+	return value;
+}
+
+// NUMA node of a processor: its directory holds a "nodeN" link. Machines without NUMA report node 0
+static int readProcessorNode(int cpu) {
+	char path[128];
+	struct dirent *entry;
+	DIR *directory;
+	int node = 0;
+	
+	snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu%d", cpu);
+	directory = opendir(path);
+	if (directory == NULL) {
+		return 0;
+	}
+	while ((entry = readdir(directory)) != NULL) {
+		if (strncmp(entry->d_name, "node", 4) == 0 && sscanf(entry->d_name + 4, "%d", &node) == 1) {
+			break;
+		}
+	}
+	closedir(directory);
+	
+	return node;
+}
+
+static int compareCompact(const void *a, const void *b) {
+	const ProcessorInfo *x = (const ProcessorInfo *)a, *y = (const ProcessorInfo *)b;
+	
+	if (x->package != y->package) {
+		return x->package - y->package;
+	}
+	if (x->core != y->core) {
+		return x->core - y->core;
+	}
+	
+	return x->cpu - y->cpu;
+}
+
+static int compareScatter(const void *a, const void *b) {
+	const ProcessorInfo *x = (const ProcessorInfo *)a, *y = (const ProcessorInfo *)b;
+	
+	if (x->sibling != y->sibling) {
+		return x->sibling - y->sibling;
+	}
+	if (x->coreRank != y->coreRank) {
+		return x->coreRank - y->coreRank;
+	}
+	
+	return x->package - y->package;
+}
+
+/* Reads the topology of the processors this process may run on, and ranks every processor among the hardware
+ * threads of its core and every core inside its package.
+ */
+static void readTopology(void) {
+	cpu_set_t allowed;
+	int cpu, i, j;
+	
+	sched_getaffinity(0, sizeof(allowed), &allowed);
+	processors = (ProcessorInfo *)malloc(sizeof(ProcessorInfo) * CPU_COUNT(&allowed));
+	numberOfProcessors = 0;
+	for (cpu = 0; cpu < CPU_SETSIZE; cpu++) {
+		if (!CPU_ISSET(cpu, &allowed)) {
+			continue;
+		}
+		processors[numberOfProcessors].cpu = cpu;
+		processors[numberOfProcessors].package = readTopologyValue(cpu, "topology/physical_package_id", 0);
+		processors[numberOfProcessors].core = readTopologyValue(cpu, "topology/core_id", cpu);
+		processors[numberOfProcessors].node = readProcessorNode(cpu);
+		numberOfProcessors++;
+	}
+	
+	// Nodes made only of memory have no processor to run on, so they are left out
+	nodes = (int *)malloc(sizeof(int) * numberOfProcessors);
+	numberOfNodes = 0;
+	for (i = 0; i < numberOfProcessors; i++) {
+		for (j = 0; j < numberOfNodes && nodes[j] < processors[i].node; j++);
+		if (j == numberOfNodes || nodes[j] != processors[i].node) {
+			memmove(&nodes[j + 1], &nodes[j], sizeof(int) * (numberOfNodes - j));
+			nodes[j] = processors[i].node;
+			numberOfNodes++;
+		}
+	}
+	
+	// In compact order, siblings of a core are adjacent and cores of a package are contiguous
+	qsort(processors, numberOfProcessors, sizeof(ProcessorInfo), compareCompact);
+	numberOfPackages = numberOfCores = 0;
+	for (i = 0; i < numberOfProcessors; i++) {
+		if (i == 0 || processors[i].package != processors[i - 1].package) {
+			numberOfPackages++;
+			numberOfCores++;
+			processors[i].sibling = 0;
+			processors[i].coreRank = 0;
+		} else if (processors[i].core != processors[i - 1].core) {
+			numberOfCores++;
+			processors[i].sibling = 0;
+			processors[i].coreRank = processors[i - 1].coreRank + 1;
+		} else {
+			processors[i].sibling = processors[i - 1].sibling + 1;
+			processors[i].coreRank = processors[i - 1].coreRank;
+		}
+	}
+}
+
+static int isNodeAvailable(int node) {
+	int i;
+	
+	for (i = 0; i < numberOfNodes && nodes[i] != node; i++);
+	
+	return i < numberOfNodes;
+}
+
+// Keeps only the processors of an explicit list such as "0,2,8-11", in the order given
+static int selectProcessorList(const char *list) {
+	ProcessorInfo *selected;
+	int first, last, cpu, length, numberOfSelected = 0, i;
+	
+	selected = (ProcessorInfo *)malloc(sizeof(ProcessorInfo) * CPU_SETSIZE);
+	while (*list != '\0') {
+		if (sscanf(list, "%d%n", &first, &length) != 1 || first < 0) {
+			free(selected);
+			return 1;
+		}
+		list += length;
+		last = first;
+		if (*list == '-' && (sscanf(list + 1, "%d%n", &last, &length) != 1 || last < first)) {
+			free(selected);
+			return 1;
+		} else if (*list == '-') {
+			list += length + 1;
+		}
+		
+		for (cpu = first; cpu <= last && numberOfSelected < CPU_SETSIZE; cpu++) {
+			for (i = 0; i < numberOfProcessors && processors[i].cpu != cpu; i++);
+			if (i == numberOfProcessors) {
+				fprintf(stderr, "Processor %d is not available\n", cpu);
+				free(selected);
+				return 1;
+			}
+			selected[numberOfSelected++] = processors[i];
+		}
+		
+		if (*list == ',') {
+			list++;
+		} else if (*list != '\0') {
+			free(selected);
+			return 1;
+		}
+	}
+	if (numberOfSelected == 0) {
+		free(selected);
+		return 1;
+	}
+	
+	free(processors);
+	processors = selected;
+	numberOfProcessors = numberOfSelected;
+	
+	return 0;
+}
+
+/* Reads the topology and selects the placement given on the command line: "none", "compact", "scatter", "node",
+ * "node:N" or a processor list. Returns non-zero if the policy is not valid on this machine.
+ */
+int initPlacement(const char *policy) {
+	readTopology();
+	
+	if (strcmp(policy, "none") == 0) {
+		placementPolicy = PLACEMENT_NONE;
+	} else if (strcmp(policy, "compact") == 0) {
+		placementPolicy = PLACEMENT_COMPACT;
+	} else if (strcmp(policy, "scatter") == 0) {
+		placementPolicy = PLACEMENT_SCATTER;
+		qsort(processors, numberOfProcessors, sizeof(ProcessorInfo), compareScatter);
+	} else if (strcmp(policy, "node") == 0) {
+		placementPolicy = PLACEMENT_NODE;
+	} else if (strncmp(policy, "node:", 5) == 0 && sscanf(policy + 5, "%d", &selectedNode) == 1 && isNodeAvailable(selectedNode)) {
+		placementPolicy = PLACEMENT_NODE;
+	} else if (selectProcessorList(policy) == 0) {
+		placementPolicy = PLACEMENT_LIST;
+	} else {
+		return 1;
+	}
+	
+	return 0;
+}
+
+// Sets on "attr" the processors of the thread "threadIndex". Returns non-zero if the affinity could not be set
+int setThreadPlacement(pthread_attr_t *attr, int threadIndex) {
+	cpu_set_t cpus;
+	int node, i;
+	
+	if (placementPolicy == PLACEMENT_NONE) {
+		return 0;
+	}
+	
+	CPU_ZERO(&cpus);
+	if (placementPolicy == PLACEMENT_NODE) {
+		node = selectedNode >= 0 ? selectedNode : nodes[threadIndex % numberOfNodes];
+		for (i = 0; i < numberOfProcessors; i++) {
+			if (processors[i].node == node) {
+				CPU_SET(processors[i].cpu, &cpus);
+			}
+		}
+	} else {
+		CPU_SET(processors[threadIndex % numberOfProcessors].cpu, &cpus);
+	}
+	
+	return pthread_attr_setaffinity_np(attr, sizeof(cpus), &cpus);
+}
+
+/* Anonymous pages are given physical memory where they are first written, so touching the whole buffer from the
+ * calling thread places it on the NUMA node that thread runs on.
+ */
+void *allocateLocalBuffer(size_t size) {
+	void *buffer;
+	
+	buffer = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (buffer == MAP_FAILED) {
+		return NULL;
+	}
+	memset(buffer, 0, size);
+	
+	return buffer;
+}
+
+void releaseLocalBuffer(void *buffer, size_t size) {
+	munmap(buffer, size);
+}
+
+#else
+
+// Thread affinity is Linux specific; elsewhere only "none" is accepted and buffers come from malloc()
+int initPlacement(const char *policy) {
+	return strcmp(policy, "none") == 0 ? 0 : 1;
+}
+
+int setThreadPlacement(pthread_attr_t *attr, int threadIndex) {
+	return 0;
+}
+
+void *allocateLocalBuffer(size_t size) {
+	return malloc(size);
+}
+
+void releaseLocalBuffer(void *buffer, size_t size) {
+	free(buffer);
+}
+
+#endif
+
+PlacementPolicy getPlacementPolicy(void) {
+	return placementPolicy;
+}
+
+/* Reports the topology and where each of the first "numberOfThreads" threads runs, as "# name = value" lines so
+ * that it can go in the header of the experiment's log.
+ */
+void writePlacement(FILE *fp, int numberOfThreads) {
+	static const char *const PolicyNames[] = {"none", "compact", "scatter", "node", "list"};
+	int i;
+	
+	fprintf(fp, "# topology = %d processors, %d cores, %d packages, %d NUMA nodes\n", numberOfProcessors, numberOfCores,
+			numberOfPackages, numberOfNodes);
+	fprintf(fp, "# placement = %s\n", PolicyNames[placementPolicy]);
+	if (placementPolicy == PLACEMENT_NONE) {
+		return;
+	}
+	
+	fprintf(fp, "# thread processors =");
+	for (i = 0; i < numberOfThreads; i++) {
+		if (placementPolicy == PLACEMENT_NODE) {
+			fprintf(fp, " node%d", selectedNode >= 0 ? selectedNode : nodes[i % numberOfNodes]);
+		} else {
+			fprintf(fp, " %d", processors[i % numberOfProcessors].cpu);
+		}
+	}
+	fprintf(fp, "\n");
+}
@@ -0,0 +1,42 @@
+/*
+    affinity.h
+    Copyright (C) 2010 Dalmo Cirne
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef AFFINITY_H
+#define AFFINITY_H
+
+#include <stdio.h>
+#include <stddef.h>
+#include <pthread.h>
+
+// Where the benchmark threads run. Thread i is the i-th thread created on an iteration
+typedef enum {
+	PLACEMENT_NONE,    // The scheduler places the threads (the original experiment)
+	PLACEMENT_COMPACT, // Thread i on the i-th processor, filling the hardware threads of a core, then a package
+	PLACEMENT_SCATTER, // Thread i spread across packages first, then cores, using hardware thread siblings last
+	PLACEMENT_NODE,    // Thread i on every processor of NUMA node i % nodes, or of a single node with "node:N"
+	PLACEMENT_LIST     // Thread i on the (i % length)-th processor of an explicit list such as "0,2,8-11"
+} PlacementPolicy;
+
+int initPlacement(const char *policy);
+PlacementPolicy getPlacementPolicy(void);
+int setThreadPlacement(pthread_attr_t *attr, int threadIndex);
+void writePlacement(FILE *fp, int numberOfThreads);
+void *allocateLocalBuffer(size_t size);
+void releaseLocalBuffer(void *buffer, size_t size);
+
+#endif
@@ -0,0 +1,232 @@
+/*
+    config.c
+    Copyright (C) 2010 Dalmo Cirne
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include "config.h"
+
+#define CONFIG_LINE_SIZE 1024
+
+/* Sets the variable of the setting called "name". Returns non-zero, leaving the variable untouched, if there is no
+ * such setting or the value is not valid for it.
+ */
+int applySetting(const Setting *settings, int numberOfSettings, const char *name, const char *value) {
+	char *end;
+	long number;
+	unsigned long unsignedNumber;
+	int i;
+	
+	for (i = 0; i < numberOfSettings; i++) {
+		if (strcmp(settings[i].name, name) != 0) {
+			continue;
+		}
+		
+		switch (settings[i].type) {
+			case SETTING_INT:
+				number = strtol(value, &end, 10);
+				if (*value == '\0' || *end != '\0' || number <= 0 || number > 0x7FFFFFFF) {
+					return 1;
+				}
+				*(int *)settings[i].value = (int)number;
+				return 0;
+			case SETTING_ULONG:
+				unsignedNumber = strtoul(value, &end, 10);
+				if (*value == '\0' || *end != '\0' || *value == '-' || unsignedNumber == 0) {
+					return 1;
+				}
+				*(unsigned long *)settings[i].value = unsignedNumber;
+				return 0;
+			case SETTING_STRING:
+				if (*value == '\0') {
+					return 1;
+				}
+				*(char **)settings[i].value = strdup(value);
+				return 0;
+		}
+	}
+	
+	return 1;
+}
+
+// Returns whether there is a setting called "name"
+static int isSetting(const Setting *settings, int numberOfSettings, const char *name) {
+	int i;
+	
+	for (i = 0; i < numberOfSettings; i++) {
+		if (strcmp(settings[i].name, name) == 0) {
+			return 1;
+		}
+	}
+	
+	return 0;
+}
+
+// Removes the blanks around a string, in place
+static char *trim(char *text) {
+	char *end;
+	
+	while (isspace((unsigned char)*text)) {
+		text++;
+	}
+	end = text + strlen(text);
+	while (end > text && isspace((unsigned char)end[-1])) {
+		end--;
+	}
+	*end = '\0';
+	
+	return text;
+}
+
+/* Applies every "name = value" line of a configuration file. Blank lines and lines starting with '#' are skipped.
+ * Returns non-zero, after reporting the offending line, if the file cannot be read or a line is not valid.
+ */
+int loadConfigFile(const Setting *settings, int numberOfSettings, const char *fileName) {
+	char line[CONFIG_LINE_SIZE], *name, *value, *separator;
+	int lineNumber = 0;
+	FILE *fp;
+	
+	fp = fopen(fileName, "r");
+	if (fp == NULL) {
+		fprintf(stderr, "Could not open configuration file %s\n", fileName);
+		return 1;
+	}
+	
+	while (fgets(line, sizeof(line), fp) != NULL) {
+		lineNumber++;
+		name = trim(line);
+		if (*name == '\0' || *name == '#') {
+			continue;
+		}
+		
+		separator = strchr(name, '=');
+		if (separator == NULL) {
+			fprintf(stderr, "%s:%d: expected \"name = value\"\n", fileName, lineNumber);
+			fclose(fp);
+			return 1;
+		}
+		*separator = '\0';
+		name = trim(name);
+		value = trim(separator + 1);
+		
+		if (applySetting(settings, numberOfSettings, name, value) != 0) {
+			fprintf(stderr, "%s:%d: invalid setting %s = %s\n", fileName, lineNumber, name, value);
+			fclose(fp);
+			return 1;
+		}
+	}
+	
+	fclose(fp);
+	
+	return 0;
+}
+
+/* Applies the "# name = value" lines that writeSettings() recorded in the log of a previous run, so that the run can
+ * be repeated. Every other line, such as the other comments and the CSV rows, is skipped. Returns non-zero, after
+ * reporting the offending line, if the file cannot be read or a recorded setting is not valid.
+ */
+int loadRunLog(const Setting *settings, int numberOfSettings, const char *fileName) {
+	char line[CONFIG_LINE_SIZE], *name, *value, *separator;
+	int lineNumber = 0;
+	FILE *fp;
+	
+	fp = fopen(fileName, "r");
+	if (fp == NULL) {
+		fprintf(stderr, "Could not open run log %s\n", fileName);
+		return 1;
+	}
+	
+	while (fgets(line, sizeof(line), fp) != NULL) {
+		lineNumber++;
+		name = trim(line);
+		if (*name != '#') {
+			continue;
+		}
+		
+		separator = strchr(name + 1, '=');
+		if (separator == NULL) {
+			continue;
+		}
+		*separator = '\0';
+		name = trim(name + 1);
+		value = trim(separator + 1);
+		if (!isSetting(settings, numberOfSettings, name)) {
+			continue;
+		}
+		
+		if (applySetting(settings, numberOfSettings, name, value) != 0) {
+			fprintf(stderr, "%s:%d: invalid setting %s = %s\n", fileName, lineNumber, name, value);
+			fclose(fp);
+			return 1;
+		}
+	}
+	
+	fclose(fp);
+	
+	return 0;
+}
+
+// Writes the settings in use as "# name = value" lines, which CSV readers skip and loadRunLog() reads back
+void writeSettings(FILE *fp, const Setting *settings, int numberOfSettings) {
+	int i;
+	
+	for (i = 0; i < numberOfSettings; i++) {
+		switch (settings[i].type) {
+			case SETTING_INT:
+				fprintf(fp, "# %s = %d\n", settings[i].name, *(int *)settings[i].value);
+				break;
+			case SETTING_ULONG:
+				fprintf(fp, "# %s = %lu\n", settings[i].name, *(unsigned long *)settings[i].value);
+				break;
+			case SETTING_STRING:
+				fprintf(fp, "# %s = %s\n", settings[i].name, *(char **)settings[i].value);
+				break;
+		}
+	}
+}
+
+// Writes the command line as a "# command line = ..." line, to record the options that are not workload settings
+void writeCommandLine(FILE *fp, int argc, char *argv[]) {
+	int i;
+	
+	fprintf(fp, "# command line =");
+	for (i = 0; i < argc; i++) {
+		fprintf(fp, " %s", argv[i]);
+	}
+	fprintf(fp, "\n");
+}
+
+/* Prefixes a printf style path format with the directory "root". Any '%' in the root is escaped, so that only the
+ * conversions of "relativeFormat" remain.
+ */
+void buildOutputFormat(char *format, size_t size, const char *root, const char *relativeFormat) {
+	size_t length = 0;
+	
+	for (; *root != '\0' && length + 2 < size; root++) {
+		if (*root == '%') {
+			format[length++] = '%';
+		}
+		format[length++] = *root;
+	}
+	if (length > 0 && format[length - 1] != '/' && length + 1 < size) {
+		format[length++] = '/';
+	}
+	format[length] = '\0';
+	
+	strncat(format, relativeFormat, size - length - 1);
+}
@@ -0,0 +1,48 @@
+/*
+    config.h
+    Copyright (C) 2010 Dalmo Cirne
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef CONFIG_H
+#define CONFIG_H
+
+#include <stdio.h>
+#include <stddef.h>
+
+// Type of the variable a setting writes to
+typedef enum {
+	SETTING_INT,   // int, must be positive
+	SETTING_ULONG, // unsigned long, must be positive
+	SETTING_STRING // char *, replaced by a copy of the value
+} SettingType;
+
+/* A workload setting, given either on the command line as "-name value" or in a configuration file as
+ * "name = value". "value" points to the global variable that holds it.
+ */
+typedef struct {
+	const char *name;
+	SettingType type;
+	void *value;
+} Setting;
+
+int applySetting(const Setting *settings, int numberOfSettings, const char *name, const char *value);
+int loadConfigFile(const Setting *settings, int numberOfSettings, const char *fileName);
+int loadRunLog(const Setting *settings, int numberOfSettings, const char *fileName);
+void writeSettings(FILE *fp, const Setting *settings, int numberOfSettings);
+void writeCommandLine(FILE *fp, int argc, char *argv[]);
+void buildOutputFormat(char *format, size_t size, const char *root, const char *relativeFormat);
+
+#endif
@@ -0,0 +1,123 @@
+/*
+    coroutine.c
+    Copyright (C) 2010 Dalmo Cirne
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdlib.h>
+#include "coroutine.h"
+
+// Executor running on the calling thread, if any
+static __thread CoroutineExecutor *currentExecutor = NULL;
+
+// Allocates the stack of a coroutine. The same coroutine and stack can be spawned again once it has finished
+void initCoroutine(Coroutine *coroutine, size_t stackSize) {
+	coroutine->stack = (char *)malloc(stackSize);
+	coroutine->stackSize = stackSize;
+	coroutine->finished = 1;
+	coroutine->next = NULL;
+}
+
+void releaseCoroutine(Coroutine *coroutine) {
+	free(coroutine->stack);
+	coroutine->stack = NULL;
+}
+
+void initExecutor(CoroutineExecutor *executor) {
+	executor->head = NULL;
+	executor->tail = NULL;
+	executor->current = NULL;
+	executor->switches = 0;
+}
+
+static void enqueueCoroutine(CoroutineExecutor *executor, Coroutine *coroutine) {
+	coroutine->next = NULL;
+	if (executor->tail == NULL) {
+		executor->head = coroutine;
+	} else {
+		executor->tail->next = coroutine;
+	}
+	executor->tail = coroutine;
+}
+
+static Coroutine *dequeueCoroutine(CoroutineExecutor *executor) {
+	Coroutine *coroutine = executor->head;
+	
+	if (coroutine != NULL) {
+		executor->head = coroutine->next;
+		if (executor->head == NULL) {
+			executor->tail = NULL;
+		}
+	}
+	
+	return coroutine;
+}
+
+// First frame of every coroutine. Returning from it resumes the executor, through "uc_link"
+static void startCoroutine(void) {
+	Coroutine *coroutine = currentExecutor->current;
+	
+	coroutine->routine(coroutine->argument);
+	coroutine->finished = 1;
+}
+
+// Queues a coroutine on an executor. Only called while the executor is not running
+void spawnCoroutine(CoroutineExecutor *executor, Coroutine *coroutine, void *(*routine)(void *), void *argument) {
+	getcontext(&coroutine->context);
+	coroutine->context.uc_stack.ss_sp = coroutine->stack;
+	coroutine->context.uc_stack.ss_size = coroutine->stackSize;
+	coroutine->context.uc_link = &executor->context;
+	makecontext(&coroutine->context, startCoroutine, 0);
+	
+	coroutine->routine = routine;
+	coroutine->argument = argument;
+	coroutine->finished = 0;
+	enqueueCoroutine(executor, coroutine);
+}
+
+/* Runs the coroutines of an executor on the calling thread until all of them have finished. A coroutine that
+ * yields goes back to the end of the queue. Has the signature of a thread function, so it can be given to
+ * pthread_create().
+ */
+void *runExecutor(void *executor) {
+	CoroutineExecutor *coroutineExecutor = (CoroutineExecutor *)executor;
+	Coroutine *coroutine;
+	
+	currentExecutor = coroutineExecutor;
+	while ((coroutine = dequeueCoroutine(coroutineExecutor)) != NULL) {
+		coroutineExecutor->current = coroutine;
+		coroutineExecutor->switches++;
+		swapcontext(&coroutineExecutor->context, &coroutine->context);
+		coroutineExecutor->current = NULL;
+		
+		if (!coroutine->finished) {
+			enqueueCoroutine(coroutineExecutor, coroutine);
+		}
+	}
+	currentExecutor = NULL;
+	
+	return NULL;
+}
+
+// Gives the processor to the next coroutine of the executor. Outside a coroutine it returns at once
+void yieldCoroutine(void) {
+	CoroutineExecutor *executor = currentExecutor;
+	
+	if (executor == NULL || executor->current == NULL) {
+		return;
+	}
+	
+	swapcontext(&executor->current->context, &executor->context);
+}
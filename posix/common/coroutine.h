@@ -0,0 +1,56 @@
+/*
+    coroutine.h
+    Copyright (C) 2010 Dalmo Cirne
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef COROUTINE_H
+#define COROUTINE_H
+
+#include <stddef.h>
+#include <ucontext.h>
+
+// Stack of every coroutine. The deepest frame it has to hold is a batch of equation points (about 6 KB)
+#define COROUTINE_STACK_SIZE (64 * 1024)
+
+// Cooperative task. Runs "routine(argument)" on a stack of its own and gives the processor back only by yielding
+typedef struct Coroutine {
+	ucontext_t context;
+	void *(*routine)(void *);
+	void *argument;
+	int finished;
+	char *stack;
+	size_t stackSize;
+	struct Coroutine *next;
+} Coroutine;
+
+/* Runs a queue of coroutines on one thread, round robin, switching only when the running coroutine yields or
+ * finishes. "switches" counts every switch into a coroutine.
+ */
+typedef struct {
+	ucontext_t context;
+	Coroutine *head, *tail;
+	Coroutine *current;
+	unsigned long switches;
+} CoroutineExecutor;
+
+void initCoroutine(Coroutine *coroutine, size_t stackSize);
+void releaseCoroutine(Coroutine *coroutine);
+void initExecutor(CoroutineExecutor *executor);
+void spawnCoroutine(CoroutineExecutor *executor, Coroutine *coroutine, void *(*routine)(void *), void *argument);
+void *runExecutor(void *executor);
+void yieldCoroutine(void);
+
+#endif
@@ -0,0 +1,396 @@
+/*
+    equation.c
+    Copyright (C) 2010 Dalmo Cirne
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include <immintrin.h>
+#include "equation.h"
+
+/* The vector kernels depend on the exact order of their floating point operations (the argument reduction of cos
+ * subtracts pi/2 in several pieces). -ffast-math would be free to reassociate them, so it is turned off from here on.
+ */
+#pragma GCC optimize ("no-fast-math")
+
+/* pi/2 split in pieces of 18 significant bits (the last one holds the rest). k * piece is exact for k < 2^35, so
+ * the reduction is exact for arguments below REDUCTION_LIMIT. Larger arguments are computed with the scalar cos.
+ */
+#define PIO2_1 0x1.921f800000000p+0
+#define PIO2_2 0x1.aa22000000000p-19
+#define PIO2_3 0x1.68c2000000000p-39
+#define PIO2_4 0x1.a62633145c06ep-58
+#define TWO_OVER_PI 0x1.45f306dc9c883p-1
+#define REDUCTION_LIMIT 5.0e10
+
+#define LN2_HI 0x1.62e42fee00000p-1
+#define LN2_LO 0x1.a39ef35793c76p-33
+#define LOG2_E 0x1.71547652b82fep+0
+
+// Taylor coefficients of sin (odd powers, from r^15 down to r^3) and cos (even powers, from r^16 down to r^2)
+static const double sinCoefficients[] = {
+	-1.0 / 1307674368000.0, 1.0 / 6227020800.0, -1.0 / 39916800.0, 1.0 / 362880.0,
+	-1.0 / 5040.0, 1.0 / 120.0, -1.0 / 6.0
+};
+static const double cosCoefficients[] = {
+	1.0 / 20922789888000.0, -1.0 / 87178291200.0, 1.0 / 479001600.0, -1.0 / 3628800.0,
+	1.0 / 40320.0, -1.0 / 720.0, 1.0 / 24.0, -1.0 / 2.0
+};
+// Taylor coefficients of exp, from r^13 down to r^1
+static const double expCoefficients[] = {
+	1.0 / 6227020800.0, 1.0 / 479001600.0, 1.0 / 39916800.0, 1.0 / 3628800.0, 1.0 / 362880.0,
+	1.0 / 40320.0, 1.0 / 5040.0, 1.0 / 720.0, 1.0 / 120.0, 1.0 / 24.0, 1.0 / 6.0, 1.0 / 2.0, 1.0
+};
+
+static void evaluateScalar(const double *x, const double *y, double *z, int count);
+static void evaluateSSE(const double *x, const double *y, double *z, int count);
+static void evaluateAVX2(const double *x, const double *y, double *z, int count);
+static void patchLargeArguments(const double *x, const double *y, double *z, int count);
+
+// Replaces KERNEL_AUTO by the widest kernel the processor supports
+EquationKernel resolveEquationKernel(EquationKernel kernel) {
+	if (kernel != KERNEL_AUTO) {
+		return kernel;
+	}
+	
+	__builtin_cpu_init();
+	if (__builtin_cpu_supports("avx2")) {
+		return KERNEL_AVX2;
+	} else if (__builtin_cpu_supports("sse4.1")) {
+		return KERNEL_SSE;
+	}
+	
+	return KERNEL_SCALAR;
+}
+
+EquationBatchFunction getEquationBatchFunction(EquationKernel kernel) {
+	switch (resolveEquationKernel(kernel)) {
+		case KERNEL_SSE:
+			return evaluateSSE;
+		case KERNEL_AVX2:
+			return evaluateAVX2;
+		default:
+			return evaluateScalar;
+	}
+}
+
+const char *getEquationKernelName(EquationKernel kernel) {
+	switch (kernel) {
+		case KERNEL_SSE:
+			return "sse";
+		case KERNEL_AVX2:
+			return "avx2";
+		case KERNEL_AUTO:
+			return "auto";
+		default:
+			return "scalar";
+	}
+}
+
+// Converts a kernel name given on the command line. Returns non-zero if the name is not recognized
+int parseEquationKernel(const char *name, EquationKernel *kernel) {
+	EquationKernel kernels[] = {KERNEL_SCALAR, KERNEL_SSE, KERNEL_AVX2, KERNEL_AUTO};
+	int i;
+	
+	for (i = 0; i < 4; i++) {
+		if (strcmp(name, getEquationKernelName(kernels[i])) == 0) {
+			*kernel = kernels[i];
+			return 0;
+		}
+	}
+	
+	return 1;
+}
+
+/* Fills a batch with "count" consecutive points of the experiment, starting at (x, y), which is the coordinate of
+ * point "firstPoint". Coordinates advance exactly as in calculateEquation(): x += i / 1.1, y += i * 1.1.
+ */
+void computeEquationBatch(EquationBatchFunction evaluate, EquationBatch *batch, double x, double y, int firstPoint, int count) {
+	int j;
+	
+	batch->x[0] = x;
+	batch->y[0] = y;
+	for (j = 0; j < count; j++) {
+		batch->x[j + 1] = batch->x[j] + (firstPoint + j) / 1.1;
+		batch->y[j + 1] = batch->y[j] + (firstPoint + j) * 1.1;
+	}
+	batch->count = count;
+	
+	evaluate(batch->x, batch->y, batch->z, count);
+}
+
+/* Coordinate of point "point" without walking the sequence. Since x and y grow by i / 1.1 and i * 1.1, they are
+ * triangular numbers: x = (point * (point - 1) / 2) / 1.1 and y = (point * (point - 1) / 2) * 1.1.
+ */
+void getClosedFormCoordinate(long point, double *x, double *y) {
+	double triangular = (double)((unsigned long)point * (point - 1) / 2);
+	
+	*x = triangular / 1.1;
+	*y = triangular * 1.1;
+}
+
+// Same as computeEquationBatch(), but every coordinate of the batch comes from its closed form
+void computeEquationBatchClosedForm(EquationBatchFunction evaluate, EquationBatch *batch, long firstPoint, int count) {
+	int j;
+	
+	for (j = 0; j <= count; j++) {
+		getClosedFormCoordinate(firstPoint + j, &batch->x[j], &batch->y[j]);
+	}
+	batch->count = count;
+	
+	evaluate(batch->x, batch->y, batch->z, count);
+}
+
+/* Evaluates points [firstPoint, firstPoint + count) with closed form coordinates, so any range can be computed
+ * independently of the others. Returns the sum of the results.
+ */
+double evaluateEquationRange(EquationBatchFunction evaluate, long firstPoint, long count) {
+	EquationBatch batch;
+	double sum = 0;
+	long i;
+	int j, size;
+	
+	for (i = 0; i < count; i += size) {
+		size = count - i < EQUATION_BATCH_SIZE ? count - i : EQUATION_BATCH_SIZE;
+		computeEquationBatchClosedForm(evaluate, &batch, firstPoint + i, size);
+		for (j = 0; j < size; j++) {
+			sum += batch.z[j];
+		}
+	}
+	
+	return sum;
+}
+
+// Evaluates the first "count" points walking the sequence, as the producer does. Returns the sum of the results
+double evaluateEquationSequence(EquationBatchFunction evaluate, long count) {
+	EquationBatch batch;
+	double x = 0, y = 0, sum = 0;
+	long i;
+	int j, size;
+	
+	for (i = 0; i < count; i += size) {
+		size = count - i < EQUATION_BATCH_SIZE ? count - i : EQUATION_BATCH_SIZE;
+		computeEquationBatch(evaluate, &batch, x, y, i, size);
+		for (j = 0; j < size; j++) {
+			sum += batch.z[j];
+		}
+		x = batch.x[size];
+		y = batch.y[size];
+	}
+	
+	return sum;
+}
+
+/* Relative tolerance between evaluateEquationSequence() and a closed form sum of the same "count" points. The walk
+ * adds to x and y on every point, so they grow as the square of the index, and so does the rounding error they carry:
+ * the sums drift apart by about 5e-6 at 20 million points and 6e-5 at 100 million. The tolerance stays at
+ * EQUATION_RANGE_TOLERANCE up to EQUATION_DRIFT_POINTS and grows with the square of "count" after that.
+ */
+double getEquationSequenceTolerance(long count) {
+	double scale = (double)count / EQUATION_DRIFT_POINTS;
+	
+	return scale > 1 ? EQUATION_RANGE_TOLERANCE * scale * scale : EQUATION_RANGE_TOLERANCE;
+}
+
+/* Runs the first "numberOfPoints" points of the experiment through both the scalar kernel and "kernel". Returns the
+ * largest relative difference found.
+ */
+double validateEquationKernel(EquationKernel kernel, int numberOfPoints) {
+	EquationBatch batch;
+	double scalarZ[EQUATION_BATCH_SIZE];
+	double x = 0, y = 0, error, maxError = 0;
+	EquationBatchFunction evaluate = getEquationBatchFunction(kernel);
+	int i, j, count;
+	
+	for (i = 0; i < numberOfPoints; i += count) {
+		count = numberOfPoints - i < EQUATION_BATCH_SIZE ? numberOfPoints - i : EQUATION_BATCH_SIZE;
+		computeEquationBatch(evaluate, &batch, x, y, i, count);
+		evaluateScalar(batch.x, batch.y, scalarZ, count);
+		
+		for (j = 0; j < count; j++) {
+			error = fabs(batch.z[j] - scalarZ[j]) / fabs(scalarZ[j]);
+			if (error > maxError) {
+				maxError = error;
+			}
+		}
+		
+		x = batch.x[count];
+		y = batch.y[count];
+	}
+	
+	return maxError;
+}
+
+/* Resolves the requested kernel and validates it against the scalar kernel over the points of the experiment.
+ * Falls back to the scalar kernel if the results differ by more than EQUATION_TOLERANCE.
+ */
+EquationKernel selectEquationKernel(EquationKernel kernel, int numberOfPoints) {
+	double error;
+	
+	kernel = resolveEquationKernel(kernel);
+	if (kernel == KERNEL_SCALAR) {
+		return kernel;
+	}
+	
+	error = validateEquationKernel(kernel, numberOfPoints);
+	if (error > EQUATION_TOLERANCE) {
+		fprintf(stderr, "Equation kernel %s differs from scalar by %g, using scalar\n", getEquationKernelName(kernel), error);
+		return KERNEL_SCALAR;
+	}
+	printf("Equation kernel: %s (max relative error %g)\n", getEquationKernelName(kernel), error);
+	
+	return kernel;
+}
+
+static void evaluateScalar(const double *x, const double *y, double *z, int count) {
+	int j;
+	
+	for (j = 0; j < count; j++) {
+		z[j] = exp(cos(sqrt(pow(x[j], 2) + pow(y[j], 2))));
+	}
+}
+
+// Recomputes with the scalar kernel the points whose cos argument is beyond the reach of the vector reduction
+static void patchLargeArguments(const double *x, const double *y, double *z, int count) {
+	int j;
+	
+	for (j = 0; j < count; j++) {
+		if (sqrt(x[j] * x[j] + y[j] * y[j]) >= REDUCTION_LIMIT) {
+			z[j] = exp(cos(sqrt(pow(x[j], 2) + pow(y[j], 2))));
+		}
+	}
+}
+
+/* SSE4.1 kernel. cos: reduces the argument to [-pi/4, pi/4] around k * pi/2, evaluates the sin or cos polynomial
+ * depending on the quadrant, and fixes the sign. exp: reduces the argument around n * ln2, evaluates the polynomial,
+ * and scales by 2^n built directly in the exponent bits.
+ */
+static void evaluateSSE(const double *x, const double *y, double *z, int count) {
+	const __m128d signMask = _mm_set1_pd(-0.0);
+	int j, c, large = 0;
+	
+	for (j = 0; j + 2 <= count; j += 2) {
+		__m128d vx = _mm_loadu_pd(x + j);
+		__m128d vy = _mm_loadu_pd(y + j);
+		__m128d r = _mm_sqrt_pd(_mm_add_pd(_mm_mul_pd(vx, vx), _mm_mul_pd(vy, vy)));
+		
+		large |= _mm_movemask_pd(_mm_cmpge_pd(r, _mm_set1_pd(REDUCTION_LIMIT)));
+		
+		__m128d k = _mm_round_pd(_mm_mul_pd(r, _mm_set1_pd(TWO_OVER_PI)), _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC);
+		r = _mm_sub_pd(r, _mm_mul_pd(k, _mm_set1_pd(PIO2_1)));
+		r = _mm_sub_pd(r, _mm_mul_pd(k, _mm_set1_pd(PIO2_2)));
+		r = _mm_sub_pd(r, _mm_mul_pd(k, _mm_set1_pd(PIO2_3)));
+		r = _mm_sub_pd(r, _mm_mul_pd(k, _mm_set1_pd(PIO2_4)));
+		
+		__m128d quadrant = _mm_sub_pd(k, _mm_mul_pd(_mm_floor_pd(_mm_mul_pd(k, _mm_set1_pd(0.25))), _mm_set1_pd(4.0)));
+		__m128d useSin = _mm_or_pd(_mm_cmpeq_pd(quadrant, _mm_set1_pd(1.0)), _mm_cmpeq_pd(quadrant, _mm_set1_pd(3.0)));
+		__m128d negate = _mm_or_pd(_mm_cmpeq_pd(quadrant, _mm_set1_pd(1.0)), _mm_cmpeq_pd(quadrant, _mm_set1_pd(2.0)));
+		
+		__m128d r2 = _mm_mul_pd(r, r);
+		__m128d s = _mm_set1_pd(sinCoefficients[0]);
+		for (c = 1; c < 7; c++) {
+			s = _mm_add_pd(_mm_mul_pd(s, r2), _mm_set1_pd(sinCoefficients[c]));
+		}
+		s = _mm_add_pd(r, _mm_mul_pd(_mm_mul_pd(r, r2), s));
+		__m128d co = _mm_set1_pd(cosCoefficients[0]);
+		for (c = 1; c < 8; c++) {
+			co = _mm_add_pd(_mm_mul_pd(co, r2), _mm_set1_pd(cosCoefficients[c]));
+		}
+		co = _mm_add_pd(_mm_mul_pd(co, r2), _mm_set1_pd(1.0));
+		
+		__m128d cosine = _mm_blendv_pd(co, s, useSin);
+		cosine = _mm_xor_pd(cosine, _mm_and_pd(negate, signMask));
+		
+		__m128d n = _mm_round_pd(_mm_mul_pd(cosine, _mm_set1_pd(LOG2_E)), _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC);
+		__m128d e = _mm_sub_pd(cosine, _mm_mul_pd(n, _mm_set1_pd(LN2_HI)));
+		e = _mm_sub_pd(e, _mm_mul_pd(n, _mm_set1_pd(LN2_LO)));
+		__m128d p = _mm_set1_pd(expCoefficients[0]);
+		for (c = 1; c < 13; c++) {
+			p = _mm_add_pd(_mm_mul_pd(p, e), _mm_set1_pd(expCoefficients[c]));
+		}
+		p = _mm_add_pd(_mm_mul_pd(p, e), _mm_set1_pd(1.0));
+		
+		__m128i exponent = _mm_slli_epi64(_mm_cvtepi32_epi64(_mm_cvtpd_epi32(n)), 52);
+		__m128d scale = _mm_castsi128_pd(_mm_add_epi64(exponent, _mm_castpd_si128(_mm_set1_pd(1.0))));
+		
+		_mm_storeu_pd(z + j, _mm_mul_pd(p, scale));
+	}
+	
+	evaluateScalar(x + j, y + j, z + j, count - j);
+	if (large) {
+		patchLargeArguments(x, y, z, j);
+	}
+}
+
+// AVX2 version of evaluateSSE(), four points at a time
+__attribute__((target("avx2")))
+static void evaluateAVX2(const double *x, const double *y, double *z, int count) {
+	const __m256d signMask = _mm256_set1_pd(-0.0);
+	int j, c, large = 0;
+	
+	for (j = 0; j + 4 <= count; j += 4) {
+		__m256d vx = _mm256_loadu_pd(x + j);
+		__m256d vy = _mm256_loadu_pd(y + j);
+		__m256d r = _mm256_sqrt_pd(_mm256_add_pd(_mm256_mul_pd(vx, vx), _mm256_mul_pd(vy, vy)));
+		
+		large |= _mm256_movemask_pd(_mm256_cmp_pd(r, _mm256_set1_pd(REDUCTION_LIMIT), _CMP_GE_OQ));
+		
+		__m256d k = _mm256_round_pd(_mm256_mul_pd(r, _mm256_set1_pd(TWO_OVER_PI)), _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC);
+		r = _mm256_sub_pd(r, _mm256_mul_pd(k, _mm256_set1_pd(PIO2_1)));
+		r = _mm256_sub_pd(r, _mm256_mul_pd(k, _mm256_set1_pd(PIO2_2)));
+		r = _mm256_sub_pd(r, _mm256_mul_pd(k, _mm256_set1_pd(PIO2_3)));
+		r = _mm256_sub_pd(r, _mm256_mul_pd(k, _mm256_set1_pd(PIO2_4)));
+		
+		__m256d quadrant = _mm256_sub_pd(k, _mm256_mul_pd(_mm256_floor_pd(_mm256_mul_pd(k, _mm256_set1_pd(0.25))), _mm256_set1_pd(4.0)));
+		__m256d useSin = _mm256_or_pd(_mm256_cmp_pd(quadrant, _mm256_set1_pd(1.0), _CMP_EQ_OQ), _mm256_cmp_pd(quadrant, _mm256_set1_pd(3.0), _CMP_EQ_OQ));
+		__m256d negate = _mm256_or_pd(_mm256_cmp_pd(quadrant, _mm256_set1_pd(1.0), _CMP_EQ_OQ), _mm256_cmp_pd(quadrant, _mm256_set1_pd(2.0), _CMP_EQ_OQ));
+		
+		__m256d r2 = _mm256_mul_pd(r, r);
+		__m256d s = _mm256_set1_pd(sinCoefficients[0]);
+		for (c = 1; c < 7; c++) {
+			s = _mm256_add_pd(_mm256_mul_pd(s, r2), _mm256_set1_pd(sinCoefficients[c]));
+		}
+		s = _mm256_add_pd(r, _mm256_mul_pd(_mm256_mul_pd(r, r2), s));
+		__m256d co = _mm256_set1_pd(cosCoefficients[0]);
+		for (c = 1; c < 8; c++) {
+			co = _mm256_add_pd(_mm256_mul_pd(co, r2), _mm256_set1_pd(cosCoefficients[c]));
+		}
+		co = _mm256_add_pd(_mm256_mul_pd(co, r2), _mm256_set1_pd(1.0));
+		
+		__m256d cosine = _mm256_blendv_pd(co, s, useSin);
+		cosine = _mm256_xor_pd(cosine, _mm256_and_pd(negate, signMask));
+		
+		__m256d n = _mm256_round_pd(_mm256_mul_pd(cosine, _mm256_set1_pd(LOG2_E)), _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC);
+		__m256d e = _mm256_sub_pd(cosine, _mm256_mul_pd(n, _mm256_set1_pd(LN2_HI)));
+		e = _mm256_sub_pd(e, _mm256_mul_pd(n, _mm256_set1_pd(LN2_LO)));
+		__m256d p = _mm256_set1_pd(expCoefficients[0]);
+		for (c = 1; c < 13; c++) {
+			p = _mm256_add_pd(_mm256_mul_pd(p, e), _mm256_set1_pd(expCoefficients[c]));
+		}
+		p = _mm256_add_pd(_mm256_mul_pd(p, e), _mm256_set1_pd(1.0));
+		
+		__m256i exponent = _mm256_slli_epi64(_mm256_cvtepi32_epi64(_mm256_cvtpd_epi32(n)), 52);
+		__m256d scale = _mm256_castsi256_pd(_mm256_add_epi64(exponent, _mm256_castpd_si256(_mm256_set1_pd(1.0))));
+		
+		_mm256_storeu_pd(z + j, _mm256_mul_pd(p, scale));
+	}
+	
+	evaluateScalar(x + j, y + j, z + j, count - j);
+	if (large) {
+		patchLargeArguments(x, y, z, j);
+	}
+}
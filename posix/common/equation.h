@@ -0,0 +1,59 @@
+/*
+    equation.h
+    Copyright (C) 2010 Dalmo Cirne
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef EQUATION_H
+#define EQUATION_H
+
+#define EQUATION_BATCH_SIZE 256
+#define EQUATION_TOLERANCE 1e-9
+#define EQUATION_RANGE_TOLERANCE 1e-6
+#define EQUATION_DRIFT_POINTS 5000000 // Points the sequential walk takes before it drifts past EQUATION_RANGE_TOLERANCE
+
+// Implementations of the equation z = exp(cos(sqrt(x^2 + y^2)))
+typedef enum {
+	KERNEL_SCALAR, // One point at a time with the libm functions
+	KERNEL_SSE,    // Two points at a time with SSE4.1
+	KERNEL_AVX2,   // Four points at a time with AVX2
+	KERNEL_AUTO    // Widest vector kernel supported by the processor
+} EquationKernel;
+
+// Batch of points stored as separate x, y and z arrays. x and y hold one extra point: the start of the next batch
+typedef struct {
+	double x[EQUATION_BATCH_SIZE + 1];
+	double y[EQUATION_BATCH_SIZE + 1];
+	double z[EQUATION_BATCH_SIZE];
+	int count;
+} EquationBatch;
+
+// Evaluates the equation for "count" points
+typedef void (*EquationBatchFunction)(const double *x, const double *y, double *z, int count);
+
+EquationKernel resolveEquationKernel(EquationKernel kernel);
+EquationBatchFunction getEquationBatchFunction(EquationKernel kernel);
+const char *getEquationKernelName(EquationKernel kernel);
+int parseEquationKernel(const char *name, EquationKernel *kernel);
+void computeEquationBatch(EquationBatchFunction evaluate, EquationBatch *batch, double x, double y, int firstPoint, int count);
+void getClosedFormCoordinate(long point, double *x, double *y);
+void computeEquationBatchClosedForm(EquationBatchFunction evaluate, EquationBatch *batch, long firstPoint, int count);
+double evaluateEquationRange(EquationBatchFunction evaluate, long firstPoint, long count);
+double evaluateEquationSequence(EquationBatchFunction evaluate, long count);
+double getEquationSequenceTolerance(long count);
+double validateEquationKernel(EquationKernel kernel, int numberOfPoints);
+EquationKernel selectEquationKernel(EquationKernel kernel, int numberOfPoints);
+
+#endif
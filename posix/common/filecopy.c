@@ -0,0 +1,305 @@
+/*
+    filecopy.c
+    Copyright (C) 2010 Dalmo Cirne
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <stdatomic.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <sys/ioctl.h>
+#ifdef __linux__
+#include <sys/sendfile.h>
+#include <linux/fs.h>
+#endif
+#include "filecopy.h"
+#include "uring.h"
+
+#define READ_WRITE_BUFFER_SIZE 65536
+
+static unsigned copyQueueDepth = URING_DEFAULT_QUEUE_DEPTH;
+
+static int copyWithBackend(CopyBackend backend, int inFd, int outFd, size_t size);
+
+const char *getCopyBackendName(CopyBackend backend) {
+	switch (backend) {
+		case COPY_FICLONE:
+			return "ficlone";
+		case COPY_FILE_RANGE:
+			return "copy_file_range";
+		case COPY_SENDFILE:
+			return "sendfile";
+		case COPY_READ_WRITE:
+			return "readwrite";
+		case COPY_URING:
+			return "uring";
+		default:
+			return "stdio";
+	}
+}
+
+// Converts a backend name given on the command line. Returns non-zero if the name is not recognized
+int parseCopyBackend(const char *name, CopyBackend *backend) {
+	CopyBackend backends[] = {COPY_STDIO, COPY_FICLONE, COPY_FILE_RANGE, COPY_SENDFILE, COPY_READ_WRITE, COPY_URING};
+	int i;
+	
+	for (i = 0; i < 6; i++) {
+		if (strcmp(name, getCopyBackendName(backends[i])) == 0) {
+			*backend = backends[i];
+			return 0;
+		}
+	}
+	
+	return 1;
+}
+
+// Converts a source mode given on the command line. Returns non-zero if the name is not recognized
+int parseSourceMode(const char *name, SourceMode *mode) {
+	if (strcmp(name, "reread") == 0) {
+		*mode = SOURCE_REREAD;
+	} else if (strcmp(name, "cache") == 0) {
+		*mode = SOURCE_CACHE;
+	} else if (strcmp(name, "mmap") == 0) {
+		*mode = SOURCE_MMAP;
+	} else {
+		return 1;
+	}
+	
+	return 0;
+}
+
+/* Reads ("cache") or maps ("mmap") the whole input file once. Returns non-zero, leaving "source" empty, if the file
+ * could not be loaded.
+ */
+int loadSourceFile(const char *fileName, SourceMode mode, SourceFile *source) {
+	struct stat inFileStatus;
+	int inFd;
+	
+	source->data = NULL;
+	source->size = 0;
+	source->mode = mode;
+	
+	inFd = open(fileName, O_RDONLY);
+	if (inFd < 0 || fstat(inFd, &inFileStatus) != 0) {
+		return 1;
+	}
+	source->size = inFileStatus.st_size;
+	
+	if (mode == SOURCE_MMAP) {
+		source->data = mmap(NULL, source->size, PROT_READ, MAP_PRIVATE | MAP_POPULATE, inFd, 0);
+		if (source->data == MAP_FAILED) {
+			source->data = NULL;
+		}
+	} else {
+		source->data = (char *)malloc(source->size);
+		if (read(inFd, source->data, source->size) != (ssize_t)source->size) {
+			free(source->data);
+			source->data = NULL;
+		}
+	}
+	close(inFd);
+	
+	return source->data == NULL ? 1 : 0;
+}
+
+void releaseSourceFile(SourceFile *source) {
+	if (source->data == NULL) {
+		return;
+	}
+	
+	if (source->mode == SOURCE_MMAP) {
+		munmap(source->data, source->size);
+	} else {
+		free(source->data);
+	}
+	source->data = NULL;
+}
+
+/* Writes files "firstFile" to "firstFile + numberOfFiles - 1", named after "outFileFormat" inside the directory of
+ * "directoryNumber", straight from the loaded input. Nothing is read from the input file.
+ */
+void replicateFileFromSource(const SourceFile *source, const char *outFileFormat, int directoryNumber, int firstFile, int numberOfFiles) {
+	char *outFile;
+	ssize_t written;
+	size_t remaining;
+	int outFd, i;
+	
+	outFile = (char *)malloc(strlen(outFileFormat) + 20);
+	for (i = firstFile; i < firstFile + numberOfFiles; i++) {
+		sprintf(outFile, outFileFormat, directoryNumber, i);
+		outFd = open(outFile, O_WRONLY | O_CREAT | O_TRUNC, S_IRUSR | S_IWUSR | S_IRGRP | S_IROTH);
+		
+		for (remaining = source->size; remaining > 0; remaining -= written) {
+			written = write(outFd, source->data + source->size - remaining, remaining);
+			if (written <= 0) {
+				fprintf(stderr, "Could not write %s: %s\n", outFile, strerror(errno));
+				break;
+			}
+		}
+		
+		close(outFd);
+	}
+	free(outFile);
+}
+
+// Submissions in flight on the io_uring backend. At least 3, the open -> write -> close chain of one file
+void setCopyQueueDepth(unsigned queueDepth) {
+	copyQueueDepth = queueDepth < 3 ? 3 : queueDepth;
+}
+
+/* Copies "size" bytes from the start of "inFd" to "outFd". If "backend" is not supported for these files it moves to
+ * the next one (ficlone, copy_file_range, sendfile, readwrite), logs the change, and leaves "backend" pointing to
+ * the one that worked so later copies start there. Returns non-zero if even the last backend failed.
+ */
+int copyFileDescriptor(CopyBackend *backend, int inFd, int outFd, size_t size) {
+	while (copyWithBackend(*backend, inFd, outFd, size) != 0) {
+		if (*backend == COPY_READ_WRITE || *backend == COPY_STDIO || *backend == COPY_URING) {
+			return 1;
+		}
+		
+		printf("File backend %s is not available (%s), falling back to %s\n", getCopyBackendName(*backend), strerror(errno),
+				getCopyBackendName((CopyBackend)(*backend + 1)));
+		*backend = (CopyBackend)(*backend + 1);
+		
+		// Discards whatever a failed backend may have written
+		if (ftruncate(outFd, 0) != 0 || lseek(outFd, 0, SEEK_SET) != 0) {
+			return 1;
+		}
+	}
+	
+	return 0;
+}
+
+/* In-kernel counterpart of the stdio replicateFile(): copies "inFileName" to files "firstFile" to
+ * "firstFile + numberOfFiles - 1", named after "outFileFormat" inside the directory of "directoryNumber". Returns the
+ * backend that was actually used. Nothing is copied if the input file cannot be read.
+ */
+CopyBackend replicateFileWithBackend(CopyBackend backend, const char *inFileName, const char *outFileFormat, int directoryNumber,
+		int firstFile, int numberOfFiles) {
+	struct stat inFileStatus;
+	char *outFile;
+	int inFd, outFd, i;
+	unsigned numberOfEnterCalls;
+	static atomic_flag uringReported = ATOMIC_FLAG_INIT;
+	
+	// io_uring works on the whole batch of files. If it is not available, the blocking pread/write copy takes over
+	if (backend == COPY_URING) {
+		if (replicateFileWithUring(inFileName, outFileFormat, directoryNumber, firstFile, numberOfFiles, copyQueueDepth, &numberOfEnterCalls) == 0) {
+			if (!atomic_flag_test_and_set(&uringReported)) {
+				printf("File backend uring: %d files in %u io_uring_enter calls (queue depth %u)\n", numberOfFiles, numberOfEnterCalls,
+						copyQueueDepth);
+			}
+			return backend;
+		}
+		
+		printf("File backend %s is not available (%s), falling back to %s\n", getCopyBackendName(backend), strerror(errno),
+				getCopyBackendName(COPY_READ_WRITE));
+		backend = COPY_READ_WRITE;
+	}
+	
+	inFd = open(inFileName, O_RDONLY);
+	if (inFd < 0 || fstat(inFd, &inFileStatus) != 0) {
+		fprintf(stderr, "Could not read %s: %s\n", inFileName, strerror(errno));
+		if (inFd >= 0) {
+			close(inFd);
+		}
+		return backend;
+	}
+	
+	outFile = (char *)malloc(strlen(outFileFormat) + 20);
+	for (i = firstFile; i < firstFile + numberOfFiles; i++) {
+		sprintf(outFile, outFileFormat, directoryNumber, i);
+		outFd = open(outFile, O_WRONLY | O_CREAT | O_TRUNC, S_IRUSR | S_IWUSR | S_IRGRP | S_IROTH);
+		
+		if (copyFileDescriptor(&backend, inFd, outFd, inFileStatus.st_size) != 0) {
+			fprintf(stderr, "Could not copy %s to %s: %s\n", inFileName, outFile, strerror(errno));
+		}
+		
+		close(outFd);
+	}
+	free(outFile);
+	
+	close(inFd);
+	
+	return backend;
+}
+
+// Single attempt to copy with one backend. Sets errno and returns non-zero on failure
+static int copyWithBackend(CopyBackend backend, int inFd, int outFd, size_t size) {
+	off_t inOffset = 0;
+	ssize_t copied;
+	size_t remaining = size;
+	char *buffer;
+	
+	switch (backend) {
+#ifdef __linux__
+		case COPY_FICLONE:
+			return ioctl(outFd, FICLONE, inFd) == 0 ? 0 : 1;
+		
+		case COPY_FILE_RANGE:
+			while (remaining > 0) {
+				copied = copy_file_range(inFd, &inOffset, outFd, NULL, remaining, 0);
+				if (copied <= 0) {
+					if (copied == 0) {
+						errno = EIO;
+					}
+					return 1;
+				}
+				remaining -= copied;
+			}
+			return 0;
+		
+		case COPY_SENDFILE:
+			while (remaining > 0) {
+				copied = sendfile(outFd, inFd, &inOffset, remaining);
+				if (copied <= 0) {
+					if (copied == 0) {
+						errno = EIO;
+					}
+					return 1;
+				}
+				remaining -= copied;
+			}
+			return 0;
+#else
+		case COPY_FICLONE:
+		case COPY_FILE_RANGE:
+		case COPY_SENDFILE:
+			errno = ENOSYS;
+			return 1;
+#endif
+		
+		default:
+			buffer = (char *)malloc(READ_WRITE_BUFFER_SIZE);
+			while (remaining > 0) {
+				copied = pread(inFd, buffer, remaining < READ_WRITE_BUFFER_SIZE ? remaining : READ_WRITE_BUFFER_SIZE, inOffset);
+				if (copied <= 0 || write(outFd, buffer, copied) != copied) {
+					free(buffer);
+					return 1;
+				}
+				inOffset += copied;
+				remaining -= copied;
+			}
+			free(buffer);
+			return 0;
+	}
+}
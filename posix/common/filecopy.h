@@ -0,0 +1,59 @@
+/*
+    filecopy.h
+    Copyright (C) 2010 Dalmo Cirne
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef FILECOPY_H
+#define FILECOPY_H
+
+#include <stddef.h>
+
+// How the contents of the input file reach each output file
+typedef enum {
+	COPY_STDIO,      // fopen/fread/fwrite through a user space buffer (the original experiment)
+	COPY_FICLONE,    // Reflink: the output shares the extents of the input, when the filesystem supports it
+	COPY_FILE_RANGE, // copy_file_range(2), copied inside the kernel
+	COPY_SENDFILE,   // sendfile(2), copied inside the kernel
+	COPY_READ_WRITE, // pread/write through a user space buffer. Last resort of the in-kernel backends
+	COPY_URING       // Linked open/write/close submissions on io_uring, a whole iteration per batch
+} CopyBackend;
+
+// Where the contents of the input file come from on each iteration
+typedef enum {
+	SOURCE_REREAD, // The input file is opened and read again for every output file (the original experiment)
+	SOURCE_CACHE,  // The input file is read once into memory at startup
+	SOURCE_MMAP    // The input file is mapped once at startup
+} SourceMode;
+
+// Contents of the input file, shared read-only by every thread and iteration
+typedef struct {
+	char *data;
+	size_t size;
+	SourceMode mode;
+} SourceFile;
+
+int parseCopyBackend(const char *name, CopyBackend *backend);
+int parseSourceMode(const char *name, SourceMode *mode);
+int loadSourceFile(const char *fileName, SourceMode mode, SourceFile *source);
+void releaseSourceFile(SourceFile *source);
+void replicateFileFromSource(const SourceFile *source, const char *outFileFormat, int directoryNumber, int firstFile, int numberOfFiles);
+const char *getCopyBackendName(CopyBackend backend);
+void setCopyQueueDepth(unsigned queueDepth);
+int copyFileDescriptor(CopyBackend *backend, int inFd, int outFd, size_t size);
+CopyBackend replicateFileWithBackend(CopyBackend backend, const char *inFileName, const char *outFileFormat, int directoryNumber,
+		int firstFile, int numberOfFiles);
+
+#endif
@@ -0,0 +1,106 @@
+/*
+    futex.c
+    Copyright (C) 2010 Dalmo Cirne
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdio.h>
+#include <sched.h>
+#include "futex.h"
+
+#ifdef __linux__
+#include <unistd.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
+#endif
+
+// Tells the processor the thread is spinning, so a sibling hyperthread gets the pipeline
+#if defined(__x86_64__) || defined(__i386__)
+#define CPU_RELAX() __builtin_ia32_pause()
+#else
+#define CPU_RELAX()
+#endif
+
+// Sleeps while "word" still holds "value". Without futexes it only gives the processor away
+static void waitOnWord(atomic_int *word, int value) {
+#ifdef __linux__
+	syscall(SYS_futex, word, FUTEX_WAIT_PRIVATE, value, NULL, NULL, 0);
+#else
+	sched_yield();
+#endif
+}
+
+static void wakeOnWord(atomic_int *word) {
+#ifdef __linux__
+	syscall(SYS_futex, word, FUTEX_WAKE_PRIVATE, 1, NULL, NULL, 0);
+#endif
+}
+
+void initFutexHandoff(FutexHandoff *handoff, unsigned spinLimit) {
+	atomic_store(&handoff->state, FUTEX_SLOT_EMPTY);
+	atomic_store(&handoff->waiters, 0);
+	handoff->spinLimit = spinLimit;
+	atomic_store(&handoff->blockedWaits, 0);
+	atomic_store(&handoff->waitCalls, 0);
+	atomic_store(&handoff->wakeCalls, 0);
+}
+
+/* Returns once the slot is in "state". The sleeper registers in "waiters" before reading the state one last time,
+ * and the other side publishes the state before reading "waiters" (both sequentially consistent), so either the
+ * sleeper sees the new state or the other side sees the sleeper. FUTEX_WAIT itself returns at once if the state
+ * changed in between.
+ */
+void waitFutexHandoff(FutexHandoff *handoff, int state) {
+	unsigned spins;
+	int current;
+	
+	for (spins = 0; spins < handoff->spinLimit; spins++) {
+		if (atomic_load_explicit(&handoff->state, memory_order_acquire) == state) {
+			return;
+		}
+		CPU_RELAX();
+	}
+	
+	atomic_fetch_add(&handoff->waiters, 1);
+	atomic_fetch_add_explicit(&handoff->blockedWaits, 1, memory_order_relaxed);
+	while ((current = atomic_load(&handoff->state)) != state) {
+		atomic_fetch_add_explicit(&handoff->waitCalls, 1, memory_order_relaxed);
+		waitOnWord(&handoff->state, current);
+	}
+	atomic_fetch_sub(&handoff->waiters, 1);
+}
+
+// Moves the slot to "state", waking the other side only if it is sleeping
+void setFutexHandoff(FutexHandoff *handoff, int state) {
+	atomic_store(&handoff->state, state);
+	if (atomic_load(&handoff->waiters) > 0) {
+		atomic_fetch_add_explicit(&handoff->wakeCalls, 1, memory_order_relaxed);
+		wakeOnWord(&handoff->state);
+	}
+}
+
+/* Prints the system calls made over "handoffs" handoffs. Every handoff has two waits and two state changes; a
+ * mutex and condition variable pair pays a system call on every one of them that finds the other side asleep.
+ */
+void printFutexHandoffSummary(FutexHandoff *handoff, unsigned long handoffs) {
+	unsigned long blockedWaits = atomic_load(&handoff->blockedWaits);
+	unsigned long waitCalls = atomic_load(&handoff->waitCalls);
+	unsigned long wakeCalls = atomic_load(&handoff->wakeCalls);
+	
+	printf("Futex handoff: %lu handoffs, %lu FUTEX_WAIT and %lu FUTEX_WAKE calls (%.3f per handoff)\n", handoffs, waitCalls,
+			wakeCalls, handoffs > 0 ? (double)(waitCalls + wakeCalls) / handoffs : 0);
+	printf("Futex handoff: %lu of %lu waits satisfied by spinning (limit %u), %lu of %lu wakes skipped\n",
+			2 * handoffs - blockedWaits, 2 * handoffs, handoff->spinLimit, 2 * handoffs - wakeCalls, 2 * handoffs);
+}
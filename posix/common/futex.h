@@ -0,0 +1,45 @@
+/*
+    futex.h
+    Copyright (C) 2010 Dalmo Cirne
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef FUTEX_H
+#define FUTEX_H
+
+#include <stdatomic.h>
+
+#define FUTEX_SLOT_EMPTY 0
+#define FUTEX_SLOT_FULL 1
+
+/* Single slot handoff between one producer and one consumer, built on a futex. Each side spins on the state word for
+ * up to "spinLimit" checks before sleeping in FUTEX_WAIT, and FUTEX_WAKE is only issued when the other side is
+ * sleeping. Only the slow paths are counted, so the fast path touches nothing but "state" and "waiters".
+ */
+typedef struct {
+	atomic_int state;
+	atomic_int waiters;
+	unsigned spinLimit;
+	atomic_ulong blockedWaits; // Waits that gave up spinning
+	atomic_ulong waitCalls;    // FUTEX_WAIT system calls
+	atomic_ulong wakeCalls;    // FUTEX_WAKE system calls
+} FutexHandoff;
+
+void initFutexHandoff(FutexHandoff *handoff, unsigned spinLimit);
+void waitFutexHandoff(FutexHandoff *handoff, int state);
+void setFutexHandoff(FutexHandoff *handoff, int state);
+void printFutexHandoffSummary(FutexHandoff *handoff, unsigned long handoffs);
+
+#endif
@@ -0,0 +1,115 @@
+/*
+    histogram.c
+    Copyright (C) 2010 Dalmo Cirne
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include "histogram.h"
+
+/* Values below HISTOGRAM_SUB_BUCKETS have a bucket each. Above that, the bucket is given by the position of the
+ * leading bit (the power of two) and the HISTOGRAM_SUB_BUCKET_BITS bits that follow it.
+ */
+static int getBucketIndex(uint64_t value) {
+	int exponent, subBucket;
+	
+	if (value < HISTOGRAM_SUB_BUCKETS) {
+		return (int)value;
+	}
+	
+	exponent = 63 - __builtin_clzll(value);
+	subBucket = (int)(value >> (exponent - HISTOGRAM_SUB_BUCKET_BITS)) & (HISTOGRAM_SUB_BUCKETS - 1);
+	
+	return HISTOGRAM_SUB_BUCKETS * (exponent - HISTOGRAM_SUB_BUCKET_BITS + 1) + subBucket;
+}
+
+// Largest value that falls in a bucket
+static uint64_t getBucketHighestValue(int index) {
+	int shift;
+	
+	if (index < HISTOGRAM_SUB_BUCKETS) {
+		return index;
+	}
+	
+	shift = index / HISTOGRAM_SUB_BUCKETS - 1;
+	
+	return (((uint64_t)(HISTOGRAM_SUB_BUCKETS + index % HISTOGRAM_SUB_BUCKETS) + 1) << shift) - 1;
+}
+
+void resetHistogram(LatencyHistogram *histogram) {
+	memset(histogram, 0, sizeof(LatencyHistogram));
+	histogram->min = UINT64_MAX;
+}
+
+void recordLatency(LatencyHistogram *histogram, uint64_t value) {
+	histogram->counts[getBucketIndex(value)]++;
+	histogram->count++;
+	if (value < histogram->min) {
+		histogram->min = value;
+	}
+	if (value > histogram->max) {
+		histogram->max = value;
+	}
+}
+
+void mergeHistogram(LatencyHistogram *destination, const LatencyHistogram *source) {
+	int i;
+	
+	for (i = 0; i < HISTOGRAM_BUCKETS; i++) {
+		destination->counts[i] += source->counts[i];
+	}
+	destination->count += source->count;
+	if (source->min < destination->min) {
+		destination->min = source->min;
+	}
+	if (source->max > destination->max) {
+		destination->max = source->max;
+	}
+}
+
+/* Smallest bucket value that at least "percentile" percent of the recorded values do not exceed, capped at the
+ * largest value recorded. Returns 0 on an empty histogram.
+ */
+uint64_t getHistogramPercentile(const LatencyHistogram *histogram, double percentile) {
+	uint64_t target, seen = 0, value;
+	int i;
+	
+	if (histogram->count == 0) {
+		return 0;
+	}
+	
+	target = (uint64_t)(percentile / 100 * histogram->count + 0.5);
+	if (target < 1) {
+		target = 1;
+	}
+	
+	for (i = 0; i < HISTOGRAM_BUCKETS; i++) {
+		seen += histogram->counts[i];
+		if (seen >= target) {
+			value = getBucketHighestValue(i);
+			return value < histogram->max ? value : histogram->max;
+		}
+	}
+	
+	return histogram->max;
+}
+
+void printHistogramSummary(const char *name, const LatencyHistogram *histogram) {
+	printf("%s (ns): p50 %llu, p99 %llu, p99.9 %llu, max %llu, %llu samples\n", name,
+		   (unsigned long long)getHistogramPercentile(histogram, 50), (unsigned long long)getHistogramPercentile(histogram, 99),
+		   (unsigned long long)getHistogramPercentile(histogram, 99.9), (unsigned long long)histogram->max,
+		   (unsigned long long)histogram->count);
+}
@@ -0,0 +1,43 @@
+/*
+    histogram.h
+    Copyright (C) 2010 Dalmo Cirne
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef HISTOGRAM_H
+#define HISTOGRAM_H
+
+#include <stdint.h>
+
+/* Every power of two is split in 2^HISTOGRAM_SUB_BUCKET_BITS linear buckets, so a recorded value is known within
+ * 1/32 (about 3%) of itself, from 1 ns up to the full range of a uint64_t.
+ */
+#define HISTOGRAM_SUB_BUCKET_BITS 5
+#define HISTOGRAM_SUB_BUCKETS (1 << HISTOGRAM_SUB_BUCKET_BITS)
+#define HISTOGRAM_BUCKETS (HISTOGRAM_SUB_BUCKETS * (64 - HISTOGRAM_SUB_BUCKET_BITS + 1))
+
+// Log-bucketed (HDR style) histogram of latencies in nanoseconds
+typedef struct {
+	uint64_t counts[HISTOGRAM_BUCKETS];
+	uint64_t count, min, max;
+} LatencyHistogram;
+
+void resetHistogram(LatencyHistogram *histogram);
+void recordLatency(LatencyHistogram *histogram, uint64_t value);
+void mergeHistogram(LatencyHistogram *destination, const LatencyHistogram *source);
+uint64_t getHistogramPercentile(const LatencyHistogram *histogram, double percentile);
+void printHistogramSummary(const char *name, const LatencyHistogram *histogram);
+
+#endif
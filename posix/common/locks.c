@@ -0,0 +1,199 @@
+/*
+    locks.c
+    Copyright (C) 2010 Dalmo Cirne
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#define _GNU_SOURCE
+#include <stdlib.h>
+#include <string.h>
+#include <sched.h>
+#include "locks.h"
+
+// Checks of a busy lock before a waiter gives its processor away. With more threads than processors the holder
+// may be waiting for one, and a waiter that only spins would keep it off
+#define LOCK_SPIN_LIMIT 128
+
+#if defined(__x86_64__) || defined(__i386__)
+#define CPU_RELAX() __builtin_ia32_pause()
+#else
+#define CPU_RELAX()
+#endif
+
+static const char *const LockKindNames[] = {"mutex", "adaptive", "spin", "ttas", "ticket", "mcs", "clh"};
+
+int parseLockKind(const char *name, LockKind *kind) {
+	int i;
+	
+	for (i = 0; i < (int)(sizeof(LockKindNames) / sizeof(LockKindNames[0])); i++) {
+		if (strcmp(name, LockKindNames[i]) == 0) {
+			*kind = (LockKind)i;
+			return 0;
+		}
+	}
+	
+	return 1;
+}
+
+const char *getLockKindName(LockKind kind) {
+	return LockKindNames[kind];
+}
+
+// Spins on a busy lock, yielding the processor every LOCK_SPIN_LIMIT checks
+static void backOff(unsigned *spins) {
+	if (++*spins < LOCK_SPIN_LIMIT) {
+		CPU_RELAX();
+	} else {
+		*spins = 0;
+		sched_yield();
+	}
+}
+
+void initCounterLock(CounterLock *lock, LockKind kind) {
+	pthread_mutexattr_t attr;
+	ClhNode *dummy;
+	
+	memset(lock, 0, sizeof(CounterLock));
+	lock->kind = kind;
+	
+	pthread_mutexattr_init(&attr);
+#ifdef PTHREAD_ADAPTIVE_MUTEX_INITIALIZER_NP
+	if (kind == LOCK_ADAPTIVE) {
+		pthread_mutexattr_settype(&attr, PTHREAD_MUTEX_ADAPTIVE_NP);
+	}
+#endif
+	pthread_mutex_init(&lock->mutex, &attr);
+	pthread_mutexattr_destroy(&attr);
+	pthread_spin_init(&lock->spin, PTHREAD_PROCESS_PRIVATE);
+	
+	atomic_store(&lock->flag, 0);
+	atomic_store(&lock->nextTicket, 0);
+	atomic_store(&lock->nowServing, 0);
+	atomic_store(&lock->mcsTail, NULL);
+	
+	// The CLH queue starts with a released node, taken over by the first thread to release the lock
+	dummy = (ClhNode *)malloc(sizeof(ClhNode));
+	atomic_store(&dummy->locked, 0);
+	atomic_store(&lock->clhTail, dummy);
+}
+
+void destroyCounterLock(CounterLock *lock) {
+	pthread_mutex_destroy(&lock->mutex);
+	pthread_spin_destroy(&lock->spin);
+	free(atomic_load(&lock->clhTail));
+}
+
+void initLockHandle(LockHandle *handle) {
+	atomic_store(&handle->mcsNode.next, NULL);
+	atomic_store(&handle->mcsNode.locked, 0);
+	handle->clhNode = (ClhNode *)malloc(sizeof(ClhNode));
+	handle->clhPredecessor = NULL;
+}
+
+void releaseLockHandle(LockHandle *handle) {
+	free(handle->clhNode);
+	handle->clhNode = NULL;
+}
+
+void acquireCounterLock(CounterLock *lock, LockHandle *handle) {
+	McsNode *mcsNode = &handle->mcsNode, *mcsPredecessor;
+	unsigned ticket, spins = 0;
+	
+	switch (lock->kind) {
+		case LOCK_MUTEX:
+		case LOCK_ADAPTIVE:
+			pthread_mutex_lock(&lock->mutex);
+			break;
+		case LOCK_SPIN:
+			pthread_spin_lock(&lock->spin);
+			break;
+		case LOCK_TTAS:
+			// Reads until the lock looks free, and only then tries to take the line exclusively
+			while (1) {
+				while (atomic_load_explicit(&lock->flag, memory_order_relaxed) != 0) {
+					backOff(&spins);
+				}
+				if (atomic_exchange_explicit(&lock->flag, 1, memory_order_acquire) == 0) {
+					break;
+				}
+			}
+			break;
+		case LOCK_TICKET:
+			ticket = atomic_fetch_add_explicit(&lock->nextTicket, 1, memory_order_relaxed);
+			while (atomic_load_explicit(&lock->nowServing, memory_order_acquire) != ticket) {
+				backOff(&spins);
+			}
+			break;
+		case LOCK_MCS:
+			atomic_store_explicit(&mcsNode->next, NULL, memory_order_relaxed);
+			atomic_store_explicit(&mcsNode->locked, 1, memory_order_relaxed);
+			mcsPredecessor = atomic_exchange_explicit(&lock->mcsTail, mcsNode, memory_order_acq_rel);
+			if (mcsPredecessor != NULL) {
+				atomic_store_explicit(&mcsPredecessor->next, mcsNode, memory_order_release);
+				while (atomic_load_explicit(&mcsNode->locked, memory_order_acquire) != 0) {
+					backOff(&spins);
+				}
+			}
+			break;
+		case LOCK_CLH:
+			atomic_store_explicit(&handle->clhNode->locked, 1, memory_order_relaxed);
+			handle->clhPredecessor = atomic_exchange_explicit(&lock->clhTail, handle->clhNode, memory_order_acq_rel);
+			while (atomic_load_explicit(&handle->clhPredecessor->locked, memory_order_acquire) != 0) {
+				backOff(&spins);
+			}
+			break;
+	}
+}
+
+void releaseCounterLock(CounterLock *lock, LockHandle *handle) {
+	McsNode *mcsNode = &handle->mcsNode, *mcsSuccessor, *expected;
+	unsigned spins = 0;
+	
+	switch (lock->kind) {
+		case LOCK_MUTEX:
+		case LOCK_ADAPTIVE:
+			pthread_mutex_unlock(&lock->mutex);
+			break;
+		case LOCK_SPIN:
+			pthread_spin_unlock(&lock->spin);
+			break;
+		case LOCK_TTAS:
+			atomic_store_explicit(&lock->flag, 0, memory_order_release);
+			break;
+		case LOCK_TICKET:
+			atomic_store_explicit(&lock->nowServing, atomic_load_explicit(&lock->nowServing, memory_order_relaxed) + 1,
+					memory_order_release);
+			break;
+		case LOCK_MCS:
+			mcsSuccessor = atomic_load_explicit(&mcsNode->next, memory_order_acquire);
+			if (mcsSuccessor == NULL) {
+				// No successor yet: either the queue is empty, or one is between joining and linking itself
+				expected = mcsNode;
+				if (atomic_compare_exchange_strong_explicit(&lock->mcsTail, &expected, NULL, memory_order_acq_rel,
+						memory_order_relaxed)) {
+					break;
+				}
+				while ((mcsSuccessor = atomic_load_explicit(&mcsNode->next, memory_order_acquire)) == NULL) {
+					backOff(&spins);
+				}
+			}
+			atomic_store_explicit(&mcsSuccessor->locked, 0, memory_order_release);
+			break;
+		case LOCK_CLH:
+			atomic_store_explicit(&handle->clhNode->locked, 0, memory_order_release);
+			handle->clhNode = handle->clhPredecessor;
+			break;
+	}
+}
@@ -0,0 +1,82 @@
+/*
+    locks.h
+    Copyright (C) 2010 Dalmo Cirne
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef LOCKS_H
+#define LOCKS_H
+
+#include <pthread.h>
+#include <stdatomic.h>
+
+#define LOCK_CACHE_LINE_SIZE 64
+
+// Algorithms that can guard a critical section
+typedef enum {
+	LOCK_MUTEX,    // Default pthread_mutex_t
+	LOCK_ADAPTIVE, // pthread_mutex_t of type PTHREAD_MUTEX_ADAPTIVE_NP: spins a while before sleeping
+	LOCK_SPIN,     // pthread_spinlock_t
+	LOCK_TTAS,     // Test and test-and-set spinlock
+	LOCK_TICKET,   // Ticket lock: FIFO, every waiter spins on the same word
+	LOCK_MCS,      // MCS queue lock: FIFO, every waiter spins on its own node
+	LOCK_CLH       // CLH queue lock: FIFO, every waiter spins on the node of its predecessor
+} LockKind;
+
+// Queue node of an MCS waiter, on a cache line of its own
+typedef struct McsNode {
+	_Atomic(struct McsNode *) next;
+	atomic_int locked;
+	char pad[LOCK_CACHE_LINE_SIZE - sizeof(struct McsNode *) - sizeof(atomic_int)];
+} McsNode;
+
+// Queue node of a CLH waiter. Nodes move between threads: on release a thread keeps the node of its predecessor
+typedef struct {
+	atomic_int locked;
+	char pad[LOCK_CACHE_LINE_SIZE - sizeof(atomic_int)];
+} ClhNode;
+
+// Lock of any kind. Only the fields of the selected kind are used; words written by waiters sit on separate lines
+typedef struct {
+	LockKind kind;
+	pthread_mutex_t mutex;
+	pthread_spinlock_t spin;
+	char padMutex[LOCK_CACHE_LINE_SIZE];
+	atomic_int flag;
+	char padFlag[LOCK_CACHE_LINE_SIZE - sizeof(atomic_int)];
+	atomic_uint nextTicket;
+	char padNextTicket[LOCK_CACHE_LINE_SIZE - sizeof(atomic_uint)];
+	atomic_uint nowServing;
+	char padNowServing[LOCK_CACHE_LINE_SIZE - sizeof(atomic_uint)];
+	_Atomic(McsNode *) mcsTail;
+	_Atomic(ClhNode *) clhTail;
+} CounterLock;
+
+// State of one thread on the queue locks. Each thread acquiring a lock needs a handle of its own
+typedef struct {
+	McsNode mcsNode;
+	ClhNode *clhNode, *clhPredecessor;
+} LockHandle;
+
+int parseLockKind(const char *name, LockKind *kind);
+const char *getLockKindName(LockKind kind);
+void initCounterLock(CounterLock *lock, LockKind kind);
+void destroyCounterLock(CounterLock *lock);
+void initLockHandle(LockHandle *handle);
+void releaseLockHandle(LockHandle *handle);
+void acquireCounterLock(CounterLock *lock, LockHandle *handle);
+void releaseCounterLock(CounterLock *lock, LockHandle *handle);
+
+#endif
@@ -0,0 +1,177 @@
+/*
+    mpmcqueue.c
+    Copyright (C) 2010 Dalmo Cirne
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <sched.h>
+#include "mpmcqueue.h"
+
+static const char *const QueueKindNames[] = {"lock", "vyukov"};
+
+int parseQueueKind(const char *name, QueueKind *kind) {
+	int i;
+	
+	for (i = 0; i < (int)(sizeof(QueueKindNames) / sizeof(QueueKindNames[0])); i++) {
+		if (strcmp(name, QueueKindNames[i]) == 0) {
+			*kind = (QueueKind)i;
+			return 0;
+		}
+	}
+	
+	return 1;
+}
+
+const char *getQueueKindName(QueueKind kind) {
+	return QueueKindNames[kind];
+}
+
+// Allocates the queue. The capacity is rounded up to a power of two so that positions can be masked
+void initMpmcQueue(MpmcQueue *queue, QueueKind kind, unsigned long capacity) {
+	queue->kind = kind;
+	queue->capacity = 1;
+	while (queue->capacity < capacity) {
+		queue->capacity <<= 1;
+	}
+	queue->mask = queue->capacity - 1;
+	queue->items = NULL;
+	queue->cells = NULL;
+	
+	if (kind == QUEUE_LOCK) {
+		pthread_mutex_init(&queue->mtx, NULL);
+		pthread_cond_init(&queue->condNotEmpty, NULL);
+		pthread_cond_init(&queue->condNotFull, NULL);
+		queue->items = (QueueItem *)malloc(queue->capacity * sizeof(QueueItem));
+	} else {
+		queue->cells = (QueueCell *)malloc(queue->capacity * sizeof(QueueCell));
+	}
+	resetMpmcQueue(queue);
+}
+
+// Empties the queue. Only called while no producer or consumer is using it
+void resetMpmcQueue(MpmcQueue *queue) {
+	unsigned long i;
+	
+	if (queue->kind == QUEUE_LOCK) {
+		queue->head = 0;
+		queue->tail = 0;
+	} else {
+		for (i = 0; i < queue->capacity; i++) {
+			atomic_store_explicit(&queue->cells[i].sequence, i, memory_order_relaxed);
+		}
+		atomic_store(&queue->enqueuePosition, 0);
+		atomic_store(&queue->dequeuePosition, 0);
+	}
+}
+
+void destroyMpmcQueue(MpmcQueue *queue) {
+	if (queue->kind == QUEUE_LOCK) {
+		pthread_cond_destroy(&queue->condNotFull);
+		pthread_cond_destroy(&queue->condNotEmpty);
+		pthread_mutex_destroy(&queue->mtx);
+	}
+	free(queue->items);
+	free(queue->cells);
+	queue->items = NULL;
+	queue->cells = NULL;
+}
+
+/* Adds an item at the tail, waiting while the queue is full. On the lock-free queue a cell is free for position P
+ * when its sequence is P; the producer claims P by advancing the enqueue position, and publishes the item by setting
+ * the sequence to P + 1. A sequence behind P means the consumers have not yet drained the cell a lap ago.
+ */
+void enqueueMpmc(MpmcQueue *queue, const QueueItem *item) {
+	unsigned long position, sequence;
+	QueueCell *cell;
+	long difference;
+	
+	if (queue->kind == QUEUE_LOCK) {
+		pthread_mutex_lock(&queue->mtx);
+		while (queue->tail - queue->head == queue->capacity) {
+			pthread_cond_wait(&queue->condNotFull, &queue->mtx);
+		}
+		queue->items[queue->tail & queue->mask] = *item;
+		queue->tail++;
+		pthread_cond_signal(&queue->condNotEmpty);
+		pthread_mutex_unlock(&queue->mtx);
+		return;
+	}
+	
+	position = atomic_load_explicit(&queue->enqueuePosition, memory_order_relaxed);
+	for (;;) {
+		cell = &queue->cells[position & queue->mask];
+		sequence = atomic_load_explicit(&cell->sequence, memory_order_acquire);
+		difference = (long)sequence - (long)position;
+		if (difference == 0) {
+			if (atomic_compare_exchange_weak_explicit(&queue->enqueuePosition, &position, position + 1,
+					memory_order_relaxed, memory_order_relaxed)) {
+				break;
+			}
+		} else {
+			if (difference < 0) {
+				sched_yield();
+			}
+			position = atomic_load_explicit(&queue->enqueuePosition, memory_order_relaxed);
+		}
+	}
+	
+	cell->item = *item;
+	atomic_store_explicit(&cell->sequence, position + 1, memory_order_release);
+}
+
+/* Takes the item at the head, waiting while the queue is empty. On the lock-free queue the item of position P is
+ * ready once its cell's sequence is P + 1; the consumer claims P by advancing the dequeue position, and frees the
+ * cell for the next lap by setting the sequence to P + capacity.
+ */
+void dequeueMpmc(MpmcQueue *queue, QueueItem *item) {
+	unsigned long position, sequence;
+	QueueCell *cell;
+	long difference;
+	
+	if (queue->kind == QUEUE_LOCK) {
+		pthread_mutex_lock(&queue->mtx);
+		while (queue->tail == queue->head) {
+			pthread_cond_wait(&queue->condNotEmpty, &queue->mtx);
+		}
+		*item = queue->items[queue->head & queue->mask];
+		queue->head++;
+		pthread_cond_signal(&queue->condNotFull);
+		pthread_mutex_unlock(&queue->mtx);
+		return;
+	}
+	
+	position = atomic_load_explicit(&queue->dequeuePosition, memory_order_relaxed);
+	for (;;) {
+		cell = &queue->cells[position & queue->mask];
+		sequence = atomic_load_explicit(&cell->sequence, memory_order_acquire);
+		difference = (long)sequence - (long)(position + 1);
+		if (difference == 0) {
+			if (atomic_compare_exchange_weak_explicit(&queue->dequeuePosition, &position, position + 1,
+					memory_order_relaxed, memory_order_relaxed)) {
+				break;
+			}
+		} else {
+			if (difference < 0) {
+				sched_yield();
+			}
+			position = atomic_load_explicit(&queue->dequeuePosition, memory_order_relaxed);
+		}
+	}
+	
+	*item = cell->item;
+	atomic_store_explicit(&cell->sequence, position + queue->capacity, memory_order_release);
+}
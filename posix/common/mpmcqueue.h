@@ -0,0 +1,75 @@
+/*
+    mpmcqueue.h
+    Copyright (C) 2010 Dalmo Cirne
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef MPMCQUEUE_H
+#define MPMCQUEUE_H
+
+#include <stdint.h>
+#include <stdatomic.h>
+#include <pthread.h>
+
+#define QUEUE_CACHE_LINE_SIZE 64
+
+// Bounded multi-producer/multi-consumer queue implementations
+typedef enum {
+	QUEUE_LOCK,  // Circular buffer guarded by a mutex, with "not full" and "not empty" condition variables
+	QUEUE_VYUKOV // Lock-free array of cells, each stamped with a sequence number (Dmitry Vyukov's bounded queue)
+} QueueKind;
+
+// Element carried by the queues: one evaluated point of the equation, and when it was enqueued on "-latency"
+typedef struct {
+	double x, y, z;
+	uint64_t publishTime;
+} QueueItem;
+
+// Cell of the lock-free queue. The sequence tells whether the cell is ready to be written or read at a position
+typedef struct {
+	atomic_ulong sequence;
+	QueueItem item;
+} QueueCell;
+
+/* Bounded queue shared by any number of producers and consumers. Both operations block: the lock-based queue sleeps
+ * on its condition variables, the lock-free one yields the processor while the queue is full or empty. The enqueue
+ * and dequeue positions of the lock-free queue live on separate cache lines.
+ */
+typedef struct {
+	QueueKind kind;
+	unsigned long capacity, mask;
+	
+	pthread_mutex_t mtx;
+	pthread_cond_t condNotEmpty, condNotFull;
+	unsigned long head, tail;
+	QueueItem *items;
+	
+	char padEnqueue[QUEUE_CACHE_LINE_SIZE];
+	atomic_ulong enqueuePosition;
+	char padDequeue[QUEUE_CACHE_LINE_SIZE - sizeof(atomic_ulong)];
+	atomic_ulong dequeuePosition;
+	char padCells[QUEUE_CACHE_LINE_SIZE - sizeof(atomic_ulong)];
+	QueueCell *cells;
+} MpmcQueue;
+
+int parseQueueKind(const char *name, QueueKind *kind);
+const char *getQueueKindName(QueueKind kind);
+void initMpmcQueue(MpmcQueue *queue, QueueKind kind, unsigned long capacity);
+void resetMpmcQueue(MpmcQueue *queue);
+void destroyMpmcQueue(MpmcQueue *queue);
+void enqueueMpmc(MpmcQueue *queue, const QueueItem *item);
+void dequeueMpmc(MpmcQueue *queue, QueueItem *item);
+
+#endif
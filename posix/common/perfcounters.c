@@ -0,0 +1,239 @@
+/*
+    perfcounters.c
+    Copyright (C) 2010 Dalmo Cirne
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <string.h>
+#include <errno.h>
+#include <pthread.h>
+#include "perfcounters.h"
+
+#ifdef __linux__
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+
+// What perf_event_open is asked for each PerfEvent
+typedef struct {
+	const char *name;
+	uint32_t type;
+	uint64_t config;
+} PerfEventInfo;
+
+static const PerfEventInfo PerfEvents[PERF_EVENTS] = {
+	{"Cycles", PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES},
+	{"Instructions", PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS},
+	{"LLC Misses", PERF_TYPE_HW_CACHE,
+	 PERF_COUNT_HW_CACHE_LL | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16)},
+	{"Branch Misses", PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES},
+	{"Context Switches", PERF_TYPE_SOFTWARE, PERF_COUNT_SW_CONTEXT_SWITCHES},
+	{"CPU Migrations", PERF_TYPE_SOFTWARE, PERF_COUNT_SW_CPU_MIGRATIONS}
+};
+#endif
+
+static int availableEvents[PERF_EVENTS];
+static int numberOfAvailableEvents;
+static int excludeKernel;
+static pthread_mutex_t mtxPerfCounts = PTHREAD_MUTEX_INITIALIZER;
+
+#ifdef __linux__
+
+// Opens one event on the calling thread, on any processor. Returns -1 if the event cannot be counted
+static int openEvent(PerfEvent event, int groupFd, int exclude) {
+	struct perf_event_attr attr;
+	
+	memset(&attr, 0, sizeof(attr));
+	attr.size = sizeof(attr);
+	attr.type = PerfEvents[event].type;
+	attr.config = PerfEvents[event].config;
+	attr.disabled = groupFd == -1;
+	attr.exclude_kernel = exclude;
+	attr.exclude_hv = 1;
+	attr.read_format = PERF_FORMAT_GROUP | PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+	
+	return (int)syscall(SYS_perf_event_open, &attr, 0, -1, groupFd, 0);
+}
+
+/* Finds out which events can be counted, first including the time spent in the kernel and, if that is not allowed,
+ * user space only. Returns the number of events available; with none the counters are left out of the run.
+ */
+int initPerfCounters(void) {
+	int fd, event;
+	
+	excludeKernel = 0;
+	fd = openEvent(PERF_CONTEXT_SWITCHES, -1, 0);
+	if (fd < 0 && (errno == EACCES || errno == EPERM)) {
+		excludeKernel = 1;
+	}
+	if (fd >= 0) {
+		close(fd);
+	}
+	
+	numberOfAvailableEvents = 0;
+	for (event = 0; event < PERF_EVENTS; event++) {
+		fd = openEvent(event, -1, excludeKernel);
+		availableEvents[event] = fd >= 0;
+		if (fd >= 0) {
+			numberOfAvailableEvents++;
+			close(fd);
+		}
+	}
+	
+	if (numberOfAvailableEvents == 0) {
+		printf("Performance counters are not available (%s), leaving them out\n", strerror(errno));
+	} else {
+		printf("Performance counters:");
+		for (event = 0; event < PERF_EVENTS; event++) {
+			if (availableEvents[event]) {
+				printf(" %s,", PerfEvents[event].name);
+			}
+		}
+		printf(" %s\n", excludeKernel ? "user space only" : "user space and kernel");
+	}
+	
+	return numberOfAvailableEvents;
+}
+
+// Opens the group on the calling thread and starts counting
+void startPerfGroup(PerfGroup *group) {
+	int event;
+	
+	group->leader = -1;
+	for (event = 0; event < PERF_EVENTS; event++) {
+		group->fds[event] = -1;
+		if (availableEvents[event]) {
+			group->fds[event] = openEvent(event, group->leader, excludeKernel);
+			if (group->leader == -1) {
+				group->leader = group->fds[event];
+			}
+		}
+	}
+	
+	if (group->leader >= 0) {
+		ioctl(group->leader, PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+		ioctl(group->leader, PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+	}
+}
+
+/* Stops counting, reads the group and closes it. Values are scaled by enabled / running time, in case the counters
+ * were shared with other groups. Events that could not be opened on this thread read as 0.
+ */
+void stopPerfGroup(PerfGroup *group, PerfCounts *counts) {
+	uint64_t buffer[3 + PERF_EVENTS];
+	double scale = 1;
+	int event, i = 0;
+	
+	resetPerfCounts(counts);
+	if (group->leader < 0) {
+		return;
+	}
+	
+	ioctl(group->leader, PERF_EVENT_IOC_DISABLE, PERF_IOC_FLAG_GROUP);
+	if (read(group->leader, buffer, sizeof(buffer)) > 0) {
+		if (buffer[2] > 0 && buffer[2] < buffer[1]) {
+			scale = (double)buffer[1] / buffer[2];
+		}
+		for (event = 0; event < PERF_EVENTS; event++) {
+			if (group->fds[event] >= 0 && (uint64_t)i < buffer[0]) {
+				counts->values[event] = (uint64_t)(buffer[3 + i++] * scale);
+			}
+		}
+	}
+	
+	for (event = 0; event < PERF_EVENTS; event++) {
+		if (group->fds[event] >= 0) {
+			close(group->fds[event]);
+		}
+	}
+}
+
+#else
+
+// perf_event_open is Linux specific; elsewhere the counters are always left out
+int initPerfCounters(void) {
+	printf("Performance counters are not available on this system, leaving them out\n");
+	
+	return 0;
+}
+
+void startPerfGroup(PerfGroup *group) {
+	group->leader = -1;
+}
+
+void stopPerfGroup(PerfGroup *group, PerfCounts *counts) {
+	resetPerfCounts(counts);
+}
+
+#endif
+
+int isPerfEnabled(void) {
+	return numberOfAvailableEvents > 0;
+}
+
+void resetPerfCounts(PerfCounts *counts) {
+	memset(counts, 0, sizeof(PerfCounts));
+}
+
+/* Runs "routine" on the calling thread. When counters are enabled, its counts are added to "counts", which may be
+ * shared by every thread of a phase.
+ */
+void *runMeasured(void *(*routine)(void *), void *argument, PerfCounts *counts) {
+	PerfGroup group;
+	PerfCounts threadCounts;
+	void *result;
+	int event;
+	
+	if (!isPerfEnabled() || counts == NULL) {
+		return routine(argument);
+	}
+	
+	startPerfGroup(&group);
+	result = routine(argument);
+	stopPerfGroup(&group, &threadCounts);
+	
+	pthread_mutex_lock(&mtxPerfCounts);
+	for (event = 0; event < PERF_EVENTS; event++) {
+		counts->values[event] += threadCounts.values[event];
+	}
+	pthread_mutex_unlock(&mtxPerfCounts);
+	
+	return result;
+}
+
+// Writes the column names of the available events of a phase, each preceded by ", "
+void writePerfHeader(FILE *fp, const char *phase) {
+#ifdef __linux__
+	int event;
+	
+	for (event = 0; event < PERF_EVENTS; event++) {
+		if (availableEvents[event]) {
+			fprintf(fp, ", %s %s", phase, PerfEvents[event].name);
+		}
+	}
+#endif
+}
+
+// Writes the counts of the available events, in the order of writePerfHeader()
+void writePerfValues(FILE *fp, const PerfCounts *counts) {
+	int event;
+	
+	for (event = 0; event < PERF_EVENTS; event++) {
+		if (availableEvents[event]) {
+			fprintf(fp, ", %llu", (unsigned long long)counts->values[event]);
+		}
+	}
+}
@@ -0,0 +1,56 @@
+/*
+    perfcounters.h
+    Copyright (C) 2010 Dalmo Cirne
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef PERFCOUNTERS_H
+#define PERFCOUNTERS_H
+
+#include <stdio.h>
+#include <stdint.h>
+
+// Events recorded for every phase. Events the kernel or the processor do not support are left out
+typedef enum {
+	PERF_CYCLES,
+	PERF_INSTRUCTIONS,
+	PERF_LLC_MISSES,
+	PERF_BRANCH_MISSES,
+	PERF_CONTEXT_SWITCHES,
+	PERF_CPU_MIGRATIONS,
+	PERF_EVENTS
+} PerfEvent;
+
+// Counters of one thread: a perf_event_open group led by the first supported event
+typedef struct {
+	int fds[PERF_EVENTS];
+	int leader;
+} PerfGroup;
+
+// Event counts, scaled up when the kernel had to multiplex the counters
+typedef struct {
+	uint64_t values[PERF_EVENTS];
+} PerfCounts;
+
+int initPerfCounters(void);
+int isPerfEnabled(void);
+void startPerfGroup(PerfGroup *group);
+void stopPerfGroup(PerfGroup *group, PerfCounts *counts);
+void resetPerfCounts(PerfCounts *counts);
+void *runMeasured(void *(*routine)(void *), void *argument, PerfCounts *counts);
+void writePerfHeader(FILE *fp, const char *phase);
+void writePerfValues(FILE *fp, const PerfCounts *counts);
+
+#endif
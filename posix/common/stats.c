@@ -0,0 +1,169 @@
+/*
+    stats.c
+    Copyright (C) 2010 Dalmo Cirne
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <math.h>
+#include "stats.h"
+
+// Fixed seed, so that the confidence intervals of a given set of samples are reproducible
+#define BOOTSTRAP_SEED 0x9E3779B97F4A7C15ULL
+
+static int compareDoubles(const void *a, const void *b) {
+	double x = *(const double *)a, y = *(const double *)b;
+	
+	return x < y ? -1 : x > y ? 1 : 0;
+}
+
+// xorshift64*: small and fast, good enough to draw resampling indexes
+static uint64_t nextRandom(uint64_t *state) {
+	*state ^= *state >> 12;
+	*state ^= *state << 25;
+	*state ^= *state >> 27;
+	
+	return *state * 0x2545F4914F6CDD1DULL;
+}
+
+// Percentile of sorted values, interpolating linearly between the two closest ranks
+static double getSortedPercentile(const double *sorted, int count, double percentile) {
+	double rank = percentile / 100 * (count - 1);
+	int lower = (int)rank;
+	
+	if (lower >= count - 1) {
+		return sorted[count - 1];
+	}
+	
+	return sorted[lower] + (rank - lower) * (sorted[lower + 1] - sorted[lower]);
+}
+
+void initSampleTable(SampleTable *table, const char *const *names, int numberOfColumns, int capacity) {
+	table->names = names;
+	table->numberOfColumns = numberOfColumns;
+	table->capacity = capacity;
+	table->count = 0;
+	table->values = (double *)malloc(sizeof(double) * numberOfColumns * capacity);
+}
+
+void freeSampleTable(SampleTable *table) {
+	free(table->values);
+	table->values = NULL;
+}
+
+// Appends the measurements of one iteration. Rows beyond the capacity of the table are ignored
+void addSampleRow(SampleTable *table, const double *row) {
+	if (table->count == table->capacity) {
+		return;
+	}
+	
+	memcpy(table->values + table->count * table->numberOfColumns, row, sizeof(double) * table->numberOfColumns);
+	table->count++;
+}
+
+/* Summarizes a column, leaving out the first "warmup" rows. The confidence interval of the mean comes from
+ * STATS_BOOTSTRAP_RESAMPLES resamples (with replacement) of the remaining rows, by the percentile method.
+ */
+void summarizeSamples(const SampleTable *table, int column, int warmup, SampleSummary *summary) {
+	double *sorted, *means, sum = 0, squares = 0, resampleSum;
+	uint64_t state = BOOTSTRAP_SEED;
+	int count, i, j;
+	
+	memset(summary, 0, sizeof(SampleSummary));
+	count = table->count - warmup;
+	if (count <= 0) {
+		return;
+	}
+	
+	sorted = (double *)malloc(sizeof(double) * count);
+	for (i = 0; i < count; i++) {
+		sorted[i] = table->values[(warmup + i) * table->numberOfColumns + column];
+		sum += sorted[i];
+	}
+	qsort(sorted, count, sizeof(double), compareDoubles);
+	
+	summary->count = count;
+	summary->mean = sum / count;
+	for (i = 0; i < count; i++) {
+		squares += (sorted[i] - summary->mean) * (sorted[i] - summary->mean);
+	}
+	summary->stddev = count > 1 ? sqrt(squares / (count - 1)) : 0;
+	summary->median = getSortedPercentile(sorted, count, 50);
+	summary->p95 = getSortedPercentile(sorted, count, 95);
+	summary->p99 = getSortedPercentile(sorted, count, 99);
+	
+	means = (double *)malloc(sizeof(double) * STATS_BOOTSTRAP_RESAMPLES);
+	for (i = 0; i < STATS_BOOTSTRAP_RESAMPLES; i++) {
+		resampleSum = 0;
+		for (j = 0; j < count; j++) {
+			resampleSum += sorted[nextRandom(&state) % count];
+		}
+		means[i] = resampleSum / count;
+	}
+	qsort(means, STATS_BOOTSTRAP_RESAMPLES, sizeof(double), compareDoubles);
+	summary->ciLow = getSortedPercentile(means, STATS_BOOTSTRAP_RESAMPLES, 2.5);
+	summary->ciHigh = getSortedPercentile(means, STATS_BOOTSTRAP_RESAMPLES, 97.5);
+	
+	free(means);
+	free(sorted);
+}
+
+/* Returns non-zero once at least STATS_MINIMUM_SAMPLES rows follow the warmup and, on every column, the confidence
+ * interval is no wider than "targetWidth" times the mean.
+ */
+int isConfidenceReached(const SampleTable *table, int warmup, double targetWidth) {
+	SampleSummary summary;
+	int column;
+	
+	if (table->count - warmup < STATS_MINIMUM_SAMPLES) {
+		return 0;
+	}
+	
+	for (column = 0; column < table->numberOfColumns; column++) {
+		summarizeSamples(table, column, warmup, &summary);
+		if (summary.ciHigh - summary.ciLow > targetWidth * fabs(summary.mean)) {
+			return 0;
+		}
+	}
+	
+	return 1;
+}
+
+// Writes the summary of every column to "fileName" and shows it on the screen
+void writeSampleSummary(const SampleTable *table, int warmup, const char *fileName) {
+	SampleSummary summary;
+	FILE *fp;
+	int column;
+	
+	if (warmup > table->count) {
+		warmup = table->count;
+	}
+	
+	fp = fopen(fileName, "w");
+	fprintf(fp, "Column, Samples, Mean, Median, Stddev, P95, P99, CI Low, CI High\n");
+	printf("Summary of %d iterations after %d warmup (95%% confidence interval of the mean):\n", table->count - warmup, warmup);
+	
+	for (column = 0; column < table->numberOfColumns; column++) {
+		summarizeSamples(table, column, warmup, &summary);
+		fprintf(fp, "%s, %d, %.3f, %.3f, %.3f, %.3f, %.3f, %.3f, %.3f\n", table->names[column], summary.count, summary.mean,
+				summary.median, summary.stddev, summary.p95, summary.p99, summary.ciLow, summary.ciHigh);
+		printf("  %-15s mean %.3f [%.3f, %.3f], median %.3f, stddev %.3f, p95 %.3f, p99 %.3f\n", table->names[column],
+			   summary.mean, summary.ciLow, summary.ciHigh, summary.median, summary.stddev, summary.p95, summary.p99);
+	}
+	
+	fclose(fp);
+}
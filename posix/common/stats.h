@@ -0,0 +1,49 @@
+/*
+    stats.h
+    Copyright (C) 2010 Dalmo Cirne
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef STATS_H
+#define STATS_H
+
+#include <stdio.h>
+
+#define STATS_BOOTSTRAP_RESAMPLES 1000
+// Samples needed after the warmup before a run may stop early on "-ci-width"
+#define STATS_MINIMUM_SAMPLES 10
+
+// Summary of one column of measurements. "ciLow" and "ciHigh" bound the 95% bootstrap confidence interval of the mean
+typedef struct {
+	int count;
+	double mean, median, stddev, p95, p99;
+	double ciLow, ciHigh;
+} SampleSummary;
+
+// Measurements of every iteration, one row per iteration and one column per measured phase
+typedef struct {
+	const char *const *names;
+	int numberOfColumns, capacity, count;
+	double *values;
+} SampleTable;
+
+void initSampleTable(SampleTable *table, const char *const *names, int numberOfColumns, int capacity);
+void freeSampleTable(SampleTable *table);
+void addSampleRow(SampleTable *table, const double *row);
+void summarizeSamples(const SampleTable *table, int column, int warmup, SampleSummary *summary);
+int isConfidenceReached(const SampleTable *table, int warmup, double targetWidth);
+void writeSampleSummary(const SampleTable *table, int warmup, const char *fileName);
+
+#endif
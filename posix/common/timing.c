@@ -0,0 +1,178 @@
+/*
+    timing.c
+    Copyright (C) 2010 Dalmo Cirne
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include "timing.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <cpuid.h>
+#include <x86intrin.h>
+#define HAVE_TSC 1
+#endif
+
+// CLOCK_MONOTONIC_RAW is Linux specific; other systems get the NTP slewed (but still monotonic) clock
+#ifdef CLOCK_MONOTONIC_RAW
+#define MONOTONIC_CLOCK CLOCK_MONOTONIC_RAW
+#else
+#define MONOTONIC_CLOCK CLOCK_MONOTONIC
+#endif
+
+// Length of the busy wait used to calibrate the TSC against the monotonic clock
+#define TSC_CALIBRATION_NANOSECONDS 50000000ULL
+// Back to back reads used to measure the cost of reading the clock
+#define OVERHEAD_SAMPLES 100000
+
+static ClockSource clockSource = CLOCK_SOURCE_MONOTONIC;
+static uint64_t timingOverhead;
+
+#ifdef HAVE_TSC
+// TSC ticks are converted to the time line of the monotonic clock, so both sources can be mixed in a run
+static uint64_t tscBase, nanosecondBase;
+static double nanosecondsPerTick;
+#endif
+
+static uint64_t readMonotonicClock(void) {
+	struct timespec ts;
+	
+	clock_gettime(MONOTONIC_CLOCK, &ts);
+	
+	return (uint64_t)ts.tv_sec * NANOSECONDS_PER_SECOND + ts.tv_nsec;
+}
+
+#ifdef HAVE_TSC
+/* rdtscp waits for every earlier instruction to execute before reading the counter, and the lfence keeps later
+ * instructions from starting before the read, so the measured region cannot leak out of either side.
+ */
+static inline uint64_t readTsc(void) {
+	unsigned int aux;
+	uint64_t tsc;
+	
+	tsc = __rdtscp(&aux);
+	_mm_lfence();
+	
+	return tsc;
+}
+
+// The TSC is only usable as a clock when it supports rdtscp and ticks at a constant rate across power states
+static int isTscUsable(void) {
+	unsigned int eax, ebx, ecx, edx;
+	
+	if (__get_cpuid(0x80000001, &eax, &ebx, &ecx, &edx) == 0 || (edx & (1 << 27)) == 0) {
+		return 0;
+	}
+	if (__get_cpuid(0x80000007, &eax, &ebx, &ecx, &edx) == 0 || (edx & (1 << 8)) == 0) {
+		return 0;
+	}
+	
+	return 1;
+}
+
+static void calibrateTsc(void) {
+	uint64_t startNanoseconds, startTicks, endNanoseconds, endTicks;
+	
+	startNanoseconds = readMonotonicClock();
+	startTicks = readTsc();
+	do {
+		endNanoseconds = readMonotonicClock();
+	} while (endNanoseconds - startNanoseconds < TSC_CALIBRATION_NANOSECONDS);
+	endTicks = readTsc();
+	
+	nanosecondsPerTick = (double)(endNanoseconds - startNanoseconds) / (endTicks - startTicks);
+	nanosecondBase = endNanoseconds;
+	tscBase = endTicks;
+}
+#endif
+
+// Converts a clock source given on the command line. Returns non-zero if the name is not recognized
+int parseClockSource(const char *name, ClockSource *source) {
+	if (strcmp(name, "monotonic") == 0) {
+		*source = CLOCK_SOURCE_MONOTONIC;
+	} else if (strcmp(name, "tsc") == 0) {
+		*source = CLOCK_SOURCE_TSC;
+	} else {
+		return 1;
+	}
+	
+	return 0;
+}
+
+const char *getClockSourceName(ClockSource source) {
+	return source == CLOCK_SOURCE_TSC ? "tsc" : "monotonic";
+}
+
+/* Selects the clock behind getTimeNanoseconds(), falling back to the monotonic clock if the TSC cannot be used, and
+ * measures how long reading it takes. Returns the clock in use.
+ */
+ClockSource initTiming(ClockSource source) {
+	struct timespec resolution;
+	uint64_t startTime;
+	int i;
+	
+	clockSource = CLOCK_SOURCE_MONOTONIC;
+	if (source == CLOCK_SOURCE_TSC) {
+#ifdef HAVE_TSC
+		if (isTscUsable()) {
+			calibrateTsc();
+			clockSource = CLOCK_SOURCE_TSC;
+		} else {
+			fprintf(stderr, "Clock tsc is not invariant on this processor, falling back to monotonic\n");
+		}
+#else
+		fprintf(stderr, "Clock tsc is not available on this architecture, falling back to monotonic\n");
+#endif
+	}
+	
+	startTime = getTimeNanoseconds();
+	for (i = 0; i < OVERHEAD_SAMPLES; i++) {
+		getTimeNanoseconds();
+	}
+	timingOverhead = (getTimeNanoseconds() - startTime) / (OVERHEAD_SAMPLES + 1);
+	
+	if (clockSource == CLOCK_SOURCE_TSC) {
+#ifdef HAVE_TSC
+		printf("Clock: tsc, %.3f GHz, %llu ns per read\n", 1 / nanosecondsPerTick, (unsigned long long)timingOverhead);
+#endif
+	} else {
+		clock_getres(MONOTONIC_CLOCK, &resolution);
+		printf("Clock: monotonic, %ld ns resolution, %llu ns per read\n", resolution.tv_nsec, (unsigned long long)timingOverhead);
+	}
+	
+	return clockSource;
+}
+
+uint64_t getTimeNanoseconds(void) {
+#ifdef HAVE_TSC
+	if (clockSource == CLOCK_SOURCE_TSC) {
+		return nanosecondBase + (uint64_t)((int64_t)(readTsc() - tscBase) * nanosecondsPerTick);
+	}
+#endif
+	
+	return readMonotonicClock();
+}
+
+// Average cost of one getTimeNanoseconds() call, measured by initTiming()
+uint64_t getTimingOverhead(void) {
+	return timingOverhead;
+}
+
+double toMilliseconds(uint64_t nanoseconds) {
+	return nanoseconds / NANOSECONDS_PER_MILLISECOND;
+}
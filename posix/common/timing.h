@@ -0,0 +1,40 @@
+/*
+    timing.h
+    Copyright (C) 2010 Dalmo Cirne
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef TIMING_H
+#define TIMING_H
+
+#include <stdint.h>
+
+#define NANOSECONDS_PER_SECOND 1000000000ULL
+#define NANOSECONDS_PER_MILLISECOND 1000000.0
+
+// Where time stamps come from
+typedef enum {
+	CLOCK_SOURCE_MONOTONIC, // clock_gettime(CLOCK_MONOTONIC_RAW): never jumps with NTP, nanosecond resolution
+	CLOCK_SOURCE_TSC        // rdtscp/lfence, calibrated against the monotonic clock at startup. x86 with an invariant TSC only
+} ClockSource;
+
+int parseClockSource(const char *name, ClockSource *source);
+const char *getClockSourceName(ClockSource source);
+ClockSource initTiming(ClockSource source);
+uint64_t getTimeNanoseconds(void);
+uint64_t getTimingOverhead(void);
+double toMilliseconds(uint64_t nanoseconds);
+
+#endif
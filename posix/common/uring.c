@@ -0,0 +1,302 @@
+/*
+    uring.c
+    Copyright (C) 2010 Dalmo Cirne
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include "uring.h"
+
+#ifdef __linux__
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <stdatomic.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <linux/io_uring.h>
+
+// Operations of a file chain, encoded in the low bits of the user data together with the slot number
+#define OPERATION_OPEN 0
+#define OPERATION_WRITE 1
+#define OPERATION_CLOSE 2
+#define OPERATION_BITS 2
+
+// Submission and completion rings shared with the kernel
+typedef struct {
+	int fd;
+	unsigned *sqHead, *sqTail, *sqMask, *sqArray;
+	unsigned *cqHead, *cqTail, *cqMask;
+	struct io_uring_sqe *sqes;
+	struct io_uring_cqe *cqes;
+	void *sqRing, *cqRing;
+	size_t sqRingSize, cqRingSize, sqesSize;
+	unsigned localTail, toSubmit;
+} URing;
+
+static int setupRing(URing *ring, unsigned entries);
+static void destroyRing(URing *ring);
+static struct io_uring_sqe *getSubmissionEntry(URing *ring);
+static int submitAndWait(URing *ring, unsigned waitFor);
+static void queueFileChain(URing *ring, int slot, const char *path, const char *buffer, size_t size);
+
+/* Copies "inFileName" to files "firstFile" to "firstFile + numberOfFiles - 1", named after "outFileFormat" inside the
+ * directory of "directoryNumber". The input is read once; each output file is then an open -> write -> close chain of linked
+ * submissions, working on a registered file slot so that the write and the close can refer to the file the open
+ * creates. "queueDepth" bounds the submissions in flight (three per file); it is raised to 3 so that at least one chain
+ * fits. Returns non-zero, with errno set, if
+ * io_uring is not available or an operation failed; the caller is expected to fall back to another backend.
+ */
+int replicateFileWithUring(const char *inFileName, const char *outFileFormat, int directoryNumber, int firstFile, int numberOfFiles,
+		unsigned queueDepth, unsigned *numberOfEnterCalls) {
+	URing ring;
+	struct stat inFileStatus;
+	int inFd, numberOfSlots, slot, nextFile, completedFiles, result = 0, error = 0;
+	int *registeredFiles;
+	char **paths, *buffer;
+	
+	inFd = open(inFileName, O_RDONLY);
+	if (inFd < 0 || fstat(inFd, &inFileStatus) != 0) {
+		return 1;
+	}
+	buffer = (char *)malloc(inFileStatus.st_size);
+	if (read(inFd, buffer, inFileStatus.st_size) != inFileStatus.st_size) {
+		close(inFd);
+		free(buffer);
+		return 1;
+	}
+	close(inFd);
+	
+	if (queueDepth < 3) {
+		queueDepth = 3;
+	}
+	if (setupRing(&ring, queueDepth) != 0) {
+		free(buffer);
+		return 1;
+	}
+	
+	// One registered file slot per chain in flight
+	numberOfSlots = (int)(queueDepth / 3) < numberOfFiles ? (int)(queueDepth / 3) : numberOfFiles;
+	if (numberOfSlots < 1) {
+		numberOfSlots = 1;
+	}
+	registeredFiles = (int *)malloc(numberOfSlots * sizeof(int));
+	paths = (char **)malloc(numberOfSlots * sizeof(char *));
+	for (slot = 0; slot < numberOfSlots; slot++) {
+		registeredFiles[slot] = -1;
+		paths[slot] = (char *)malloc(strlen(outFileFormat) + 20);
+	}
+	
+	if (syscall(__NR_io_uring_register, ring.fd, IORING_REGISTER_FILES, registeredFiles, numberOfSlots) != 0) {
+		error = errno;
+		result = 1;
+	}
+	
+	// Keeps every slot busy until all files have been queued, then drains the remaining chains
+	nextFile = firstFile;
+	completedFiles = 0;
+	for (slot = 0; slot < numberOfSlots && result == 0; slot++) {
+		sprintf(paths[slot], outFileFormat, directoryNumber, nextFile++);
+		queueFileChain(&ring, slot, paths[slot], buffer, inFileStatus.st_size);
+	}
+	
+	*numberOfEnterCalls = 0;
+	while (completedFiles < numberOfFiles && result == 0) {
+		if (submitAndWait(&ring, 1) != 0) {
+			error = errno;
+			result = 1;
+			break;
+		}
+		(*numberOfEnterCalls)++;
+		
+		unsigned head = *ring.cqHead;
+		unsigned tail = atomic_load_explicit((_Atomic unsigned *)ring.cqTail, memory_order_acquire);
+		for (; head != tail; head++) {
+			struct io_uring_cqe *cqe = &ring.cqes[head & *ring.cqMask];
+			int operation = cqe->user_data & ((1 << OPERATION_BITS) - 1);
+			
+			slot = cqe->user_data >> OPERATION_BITS;
+			if ((cqe->res < 0 && cqe->res != -ECANCELED) ||
+					(operation == OPERATION_WRITE && cqe->res >= 0 && cqe->res != inFileStatus.st_size)) {
+				error = cqe->res < 0 ? -cqe->res : EIO;
+				result = 1;
+			}
+			
+			// The close is the last completion of a chain; the slot can take the next file
+			if (operation == OPERATION_CLOSE) {
+				completedFiles++;
+				if (nextFile < firstFile + numberOfFiles) {
+					sprintf(paths[slot], outFileFormat, directoryNumber, nextFile++);
+					queueFileChain(&ring, slot, paths[slot], buffer, inFileStatus.st_size);
+				}
+			}
+		}
+		atomic_store_explicit((_Atomic unsigned *)ring.cqHead, head, memory_order_release);
+	}
+	
+	for (slot = 0; slot < numberOfSlots; slot++) {
+		free(paths[slot]);
+	}
+	free(paths);
+	free(registeredFiles);
+	destroyRing(&ring);
+	free(buffer);
+	
+	errno = error;
+	return result;
+}
+
+// Queues the open -> write -> close chain of one output file on a registered file slot
+static void queueFileChain(URing *ring, int slot, const char *path, const char *buffer, size_t size) {
+	struct io_uring_sqe *sqe;
+	
+	sqe = getSubmissionEntry(ring);
+	sqe->opcode = IORING_OP_OPENAT;
+	sqe->fd = AT_FDCWD;
+	sqe->addr = (unsigned long)path;
+	sqe->open_flags = O_WRONLY | O_CREAT | O_TRUNC;
+	sqe->len = S_IRUSR | S_IWUSR | S_IRGRP | S_IROTH;
+	sqe->file_index = slot + 1;
+	sqe->flags = IOSQE_IO_LINK;
+	sqe->user_data = ((unsigned long)slot << OPERATION_BITS) | OPERATION_OPEN;
+	
+	sqe = getSubmissionEntry(ring);
+	sqe->opcode = IORING_OP_WRITE;
+	sqe->fd = slot;
+	sqe->addr = (unsigned long)buffer;
+	sqe->len = size;
+	sqe->off = 0;
+	sqe->flags = IOSQE_FIXED_FILE | IOSQE_IO_LINK;
+	sqe->user_data = ((unsigned long)slot << OPERATION_BITS) | OPERATION_WRITE;
+	
+	sqe = getSubmissionEntry(ring);
+	sqe->opcode = IORING_OP_CLOSE;
+	sqe->file_index = slot + 1;
+	sqe->user_data = ((unsigned long)slot << OPERATION_BITS) | OPERATION_CLOSE;
+}
+
+// Creates the ring and maps its submission queue, completion queue and submission entries
+static int setupRing(URing *ring, unsigned entries) {
+	struct io_uring_params params;
+	
+	memset(ring, 0, sizeof(URing));
+	memset(&params, 0, sizeof(params));
+	ring->fd = syscall(__NR_io_uring_setup, entries, &params);
+	if (ring->fd < 0) {
+		return 1;
+	}
+	
+	ring->sqRingSize = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+	ring->cqRingSize = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+	if (params.features & IORING_FEAT_SINGLE_MMAP) {
+		if (ring->cqRingSize > ring->sqRingSize) {
+			ring->sqRingSize = ring->cqRingSize;
+		}
+		ring->cqRingSize = ring->sqRingSize;
+	}
+	
+	ring->sqRing = mmap(NULL, ring->sqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring->fd, IORING_OFF_SQ_RING);
+	if (ring->sqRing == MAP_FAILED) {
+		close(ring->fd);
+		return 1;
+	}
+	if (params.features & IORING_FEAT_SINGLE_MMAP) {
+		ring->cqRing = ring->sqRing;
+	} else {
+		ring->cqRing = mmap(NULL, ring->cqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring->fd, IORING_OFF_CQ_RING);
+		if (ring->cqRing == MAP_FAILED) {
+			munmap(ring->sqRing, ring->sqRingSize);
+			close(ring->fd);
+			return 1;
+		}
+	}
+	
+	ring->sqesSize = params.sq_entries * sizeof(struct io_uring_sqe);
+	ring->sqes = mmap(NULL, ring->sqesSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring->fd, IORING_OFF_SQES);
+	if (ring->sqes == MAP_FAILED) {
+		destroyRing(ring);
+		return 1;
+	}
+	
+	ring->sqHead = (unsigned *)((char *)ring->sqRing + params.sq_off.head);
+	ring->sqTail = (unsigned *)((char *)ring->sqRing + params.sq_off.tail);
+	ring->sqMask = (unsigned *)((char *)ring->sqRing + params.sq_off.ring_mask);
+	ring->sqArray = (unsigned *)((char *)ring->sqRing + params.sq_off.array);
+	ring->cqHead = (unsigned *)((char *)ring->cqRing + params.cq_off.head);
+	ring->cqTail = (unsigned *)((char *)ring->cqRing + params.cq_off.tail);
+	ring->cqMask = (unsigned *)((char *)ring->cqRing + params.cq_off.ring_mask);
+	ring->cqes = (struct io_uring_cqe *)((char *)ring->cqRing + params.cq_off.cqes);
+	ring->localTail = *ring->sqTail;
+	
+	return 0;
+}
+
+static void destroyRing(URing *ring) {
+	if (ring->sqes != NULL && ring->sqes != MAP_FAILED) {
+		munmap(ring->sqes, ring->sqesSize);
+	}
+	if (ring->cqRing != ring->sqRing) {
+		munmap(ring->cqRing, ring->cqRingSize);
+	}
+	munmap(ring->sqRing, ring->sqRingSize);
+	close(ring->fd);
+}
+
+/* Next free submission entry, cleared. It becomes visible to the kernel on the next submitAndWait(). The number of
+ * chains in flight is bounded by the queue depth, so the submission queue never overflows.
+ */
+static struct io_uring_sqe *getSubmissionEntry(URing *ring) {
+	unsigned index = ring->localTail & *ring->sqMask;
+	struct io_uring_sqe *sqe = &ring->sqes[index];
+	
+	memset(sqe, 0, sizeof(struct io_uring_sqe));
+	ring->sqArray[index] = index;
+	ring->localTail++;
+	ring->toSubmit++;
+	
+	return sqe;
+}
+
+// Submits the queued entries and waits for at least "waitFor" completions, all in a single system call
+static int submitAndWait(URing *ring, unsigned waitFor) {
+	int submitted;
+	
+	atomic_store_explicit((_Atomic unsigned *)ring->sqTail, ring->localTail, memory_order_release);
+	do {
+		submitted = syscall(__NR_io_uring_enter, ring->fd, ring->toSubmit, waitFor, IORING_ENTER_GETEVENTS, NULL, 0);
+	} while (submitted < 0 && errno == EINTR);
+	
+	if (submitted < 0) {
+		return 1;
+	}
+	ring->toSubmit -= submitted;
+	
+	return 0;
+}
+
+#else
+
+// io_uring only exists on Linux
+int replicateFileWithUring(const char *inFileName, const char *outFileFormat, int directoryNumber, int firstFile, int numberOfFiles,
+		unsigned queueDepth, unsigned *numberOfEnterCalls) {
+	errno = ENOSYS;
+	return 1;
+}
+
+#endif
@@ -0,0 +1,29 @@
+/*
+    uring.h
+    Copyright (C) 2010 Dalmo Cirne
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef URING_H
+#define URING_H
+
+#include <stddef.h>
+
+#define URING_DEFAULT_QUEUE_DEPTH 96
+
+int replicateFileWithUring(const char *inFileName, const char *outFileFormat, int directoryNumber, int firstFile, int numberOfFiles,
+		unsigned queueDepth, unsigned *numberOfEnterCalls);
+
+#endif
@@ -18,21 +18,30 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <math.h>
 #include <sys/stat.h>
-#include <sys/time.h>
+#include "../common/equation.h"
+#include "../common/filecopy.h"
+#include "../common/timing.h"
+#include "../common/stats.h"
+#include "../common/config.h"
+#include "../common/perfcounters.h"
 
-#define outFileName "outfiles%d/gpl.%d.txt"
-#define dirName "outfiles%d"
+#define OUT_FILE_FORMAT "outfiles%d/gpl.%d.txt"
+#define DIR_FORMAT "outfiles%d"
+#define PATH_SIZE 4096
+#define NUMBER_OF_SETTINGS (int)(sizeof(settings) / sizeof(Setting))
 #define SCREENING 1
 
-// Time tracker structure. Holds all time measurements relevant to this experiment.
+// Time tracker structure. Holds all time measurements relevant to this experiment, in nanoseconds.
 typedef struct {
-	double startTime, elapsedTime;
-	double iteractionStartTime, iteractionElapsedTime;
-	double counterStartTime, counterElapsedTime;
-	double equationStartTime, equationElapsedTime;
-	double fileStartTime, fileElapsedTime;
+	uint64_t startTime, elapsedTime;
+	uint64_t iteractionStartTime, iteractionElapsedTime;
+	uint64_t counterStartTime, counterElapsedTime;
+	uint64_t equationStartTime, equationElapsedTime;
+	uint64_t fileStartTime, fileElapsedTime;
+	uint64_t fileReadElapsedTime, fileWriteElapsedTime;
 } TimeTracker;
 
 // Structure containing the equation of 2 variables coordinates (x, y), its result (z) and the number of points to calculate
@@ -45,44 +54,111 @@ EquationCoordinate cord;
 TimeTracker timeTracker;
 
 // Global variables
-const int numberIteractions = 100;
-const int numberOfOutputFiles = 100;
-const int numberOfEquationPoints = 200000;
-const unsigned long numberOfCounterIncrements = 100000000;
-char *const inFileName = "gpl.txt";
+int numberIteractions = 100;
+int numberOfOutputFiles = 100;
+int numberOfEquationPoints = 200000;
+unsigned long numberOfCounterIncrements = 100000000;
+char *inFileName = "gpl.txt";
+char *outputRoot = ".";
+char outFileName[PATH_SIZE], dirName[PATH_SIZE];
+
+// Workload settings, given as "-name value" on the command line or as "name = value" in a "-config" file
+const Setting settings[] = {
+	{"iterations", SETTING_INT, &numberIteractions},
+	{"output-files", SETTING_INT, &numberOfOutputFiles},
+	{"equation-points", SETTING_INT, &numberOfEquationPoints},
+	{"counter-increments", SETTING_ULONG, &numberOfCounterIncrements},
+	{"input", SETTING_STRING, &inFileName},
+	{"output-root", SETTING_STRING, &outputRoot}
+};
 unsigned long counter;
 int dirNumber;
+EquationKernel equationKernel = KERNEL_SCALAR;
+EquationBatchFunction evaluateEquation;
+CopyBackend copyBackend = COPY_STDIO;
+ClockSource clockSource = CLOCK_SOURCE_MONOTONIC;
+int warmupIterations = 5;
+double confidenceWidth = 0;
+const char *const SummaryColumns[] = {"Counter Time", "Equation Time", "File Time", "Iteration Time"};
+SourceMode sourceMode = SOURCE_REREAD;
+SourceFile sourceFile;
+int measurePerf = 0;
+PerfCounts counterPerf, equationPerf, filePerf;
 char *const FileName = "Posix.Linear.csv";
+char *const SummaryFileName = "Posix.Linear.Summary.csv";
 
 // Prototypes of functions 
-double getTimeMilliseconds();
 void incrementCounter(unsigned long numIncs);
 void replicateFile(int directoryNumber);
 void ProduceEquationResults(int i);
 void ConsumeEquationResults();
+void CalculateEquationBatches();
+int parseArguments(int argc, char *argv[]);
 
 /* Executes the experiment 'numberIteractions' times. On each cycle integer, floating point, and I/O operations
  * are performed.
  */
 int main(int argc, char *argv[]) {
-	// Starts counting time
-	timeTracker.startTime = getTimeMilliseconds();
-	
 	// Declaration of variables
+	PerfGroup perfGroup;
 	char *dName;
 	FILE *fp;
-	double currentTime;
+	uint64_t currentTime;
 			
+	if (parseArguments(argc, argv) != 0) {
+		return 1;
+	}
+	clockSource = initTiming(clockSource);
+	
+	// Output directories and files are created under "outputRoot"
+	buildOutputFormat(outFileName, sizeof(outFileName), outputRoot, OUT_FILE_FORMAT);
+	buildOutputFormat(dirName, sizeof(dirName), outputRoot, DIR_FORMAT);
+	mkdir(outputRoot, S_IRWXU | S_IRGRP | S_IXGRP | S_IROTH | S_IXOTH);
+	
+	if (measurePerf) {
+		measurePerf = initPerfCounters() > 0;
+	}
+	
+	// Starts counting time, once the clock is calibrated
+	timeTracker.startTime = getTimeNanoseconds();
+
 	cord.qtdPointsToCalculate = numberOfEquationPoints;
+	equationKernel = selectEquationKernel(equationKernel, numberOfEquationPoints);
+	evaluateEquation = getEquationBatchFunction(equationKernel);
+	if (copyBackend != COPY_STDIO) {
+		printf("File backend: %s\n", getCopyBackendName(copyBackend));
+	}
+	
+	// The input file can be loaded once and shared by every iteration instead of being read again for every output
+	if (sourceMode != SOURCE_REREAD) {
+		currentTime = getTimeNanoseconds();
+		if (loadSourceFile(inFileName, sourceMode, &sourceFile) != 0) {
+			fprintf(stderr, "Could not load %s, reading it on every iteration\n", inFileName);
+		}
+		printf("Source file loaded once in %.3f\n", toMilliseconds(getTimeNanoseconds() - currentTime));
+	}
 	
 	// Creates file to host the experiment's log	
 	fp = fopen(FileName, "w");
-	fprintf(fp, "Elapsed Time, Iteration Time, Counter Time, Equation Time, File Time\n");
+	writeSettings(fp, settings, NUMBER_OF_SETTINGS);
+	writeCommandLine(fp, argc, argv);
+	fprintf(fp, "# kernel = %s\n", getEquationKernelName(equationKernel));
+	fprintf(fp, "Elapsed Time, Iteration Time, Counter Time, Equation Time, File Time, File Read Time, File Write Time");
+	if (measurePerf) {
+		writePerfHeader(fp, "Counter");
+		writePerfHeader(fp, "Equation");
+		writePerfHeader(fp, "File");
+	}
+	fprintf(fp, "\n");
 
 	// Loops "numberIteractions" times to generate enough statistical data for analysis
+	SampleTable samples;
+	double sampleRow[4];
+	initSampleTable(&samples, SummaryColumns, 4, numberIteractions);
+	
 	int iteraction, i;
 	for (iteraction = 0; iteraction < numberIteractions; iteraction++) {
-		timeTracker.iteractionStartTime = getTimeMilliseconds();
+		timeTracker.iteractionStartTime = getTimeNanoseconds();
 		counter = 0;
 		timeTracker.counterStartTime = 0;
 		
@@ -99,40 +175,82 @@ int main(int argc, char *argv[]) {
         // Executes the tasks in linear (serial) fashion.
         
         // Increments the counter
+        if (measurePerf) {
+            startPerfGroup(&perfGroup);
+        }
         incrementCounter(numberOfCounterIncrements);
+        if (measurePerf) {
+            stopPerfGroup(&perfGroup, &counterPerf);
+            startPerfGroup(&perfGroup);
+        }
         
         // Calculates equation coordinates
-        timeTracker.equationStartTime = getTimeMilliseconds(); 
-        for (i = 0; i < cord.qtdPointsToCalculate; i++) {
-            ProduceEquationResults(i);
-            ConsumeEquationResults();
+        timeTracker.equationStartTime = getTimeNanoseconds(); 
+        if (equationKernel != KERNEL_SCALAR) {
+            CalculateEquationBatches();
+        } else {
+            for (i = 0; i < cord.qtdPointsToCalculate; i++) {
+                ProduceEquationResults(i);
+                ConsumeEquationResults();
+            }
+        }
+        timeTracker.equationElapsedTime = getTimeNanoseconds() - timeTracker.equationStartTime;
+        if (measurePerf) {
+            stopPerfGroup(&perfGroup, &equationPerf);
+            startPerfGroup(&perfGroup);
         }
-        timeTracker.equationElapsedTime = getTimeMilliseconds() - timeTracker.equationStartTime;
 
         // Replicates file
         replicateFile(dirNumber);
+        if (measurePerf) {
+            stopPerfGroup(&perfGroup, &filePerf);
+        }
 
         // Saves result of the current iteration on the log file
-		currentTime = getTimeMilliseconds();
+		currentTime = getTimeNanoseconds();
 		timeTracker.iteractionElapsedTime = currentTime - timeTracker.iteractionStartTime;
 		timeTracker.elapsedTime = currentTime - timeTracker.startTime;
-		fprintf(fp, "%.3f, %.3f, %.3f, %.3f, %.3f\n", timeTracker.elapsedTime, timeTracker.iteractionElapsedTime, timeTracker.counterElapsedTime,
-				timeTracker.equationElapsedTime, timeTracker.fileElapsedTime);
+		fprintf(fp, "%.3f, %.3f, %.3f, %.3f, %.3f, %.3f, %.3f", toMilliseconds(timeTracker.elapsedTime),
+				toMilliseconds(timeTracker.iteractionElapsedTime), toMilliseconds(timeTracker.counterElapsedTime),
+				toMilliseconds(timeTracker.equationElapsedTime), toMilliseconds(timeTracker.fileElapsedTime),
+				toMilliseconds(timeTracker.fileReadElapsedTime), toMilliseconds(timeTracker.fileWriteElapsedTime));
+		if (measurePerf) {
+			writePerfValues(fp, &counterPerf);
+			writePerfValues(fp, &equationPerf);
+			writePerfValues(fp, &filePerf);
+		}
+		fprintf(fp, "\n");
 		
         // If running on screening mode, also show the results on the screen
 		#if SCREENING == 1 
-			printf("%d -> %.3f, %.3f, %.3f, %.3f, %.3f\n", iteraction, timeTracker.elapsedTime, timeTracker.iteractionElapsedTime,
-                   timeTracker.counterElapsedTime, timeTracker.equationElapsedTime, timeTracker.fileElapsedTime);
+			printf("%d -> %.3f, %.3f, %.3f, %.3f, %.3f, %.3f, %.3f\n", iteraction, toMilliseconds(timeTracker.elapsedTime),
+                   toMilliseconds(timeTracker.iteractionElapsedTime), toMilliseconds(timeTracker.counterElapsedTime),
+                   toMilliseconds(timeTracker.equationElapsedTime), toMilliseconds(timeTracker.fileElapsedTime),
+                   toMilliseconds(timeTracker.fileReadElapsedTime), toMilliseconds(timeTracker.fileWriteElapsedTime));
 		#endif
+		
+		// Stops once every phase is measured precisely enough, without waiting for the remaining iterations
+		sampleRow[0] = toMilliseconds(timeTracker.counterElapsedTime);
+		sampleRow[1] = toMilliseconds(timeTracker.equationElapsedTime);
+		sampleRow[2] = toMilliseconds(timeTracker.fileElapsedTime);
+		sampleRow[3] = toMilliseconds(timeTracker.iteractionElapsedTime);
+		addSampleRow(&samples, sampleRow);
+		if (confidenceWidth > 0 && isConfidenceReached(&samples, warmupIterations, confidenceWidth)) {
+			printf("Confidence interval within %.3f of the mean after %d iterations, stopping\n", confidenceWidth, iteraction + 1);
+			break;
+		}
 	}
 	
 	fclose(fp); // Closes experiment's log file
+	writeSampleSummary(&samples, warmupIterations, SummaryFileName);
+	freeSampleTable(&samples);
+	releaseSourceFile(&sourceFile);
     return 0;
 }
 
 // Increments a counter "numIncs" times. Only one thread can execute it at any given time.
 void incrementCounter(unsigned long numIncs) {
-	timeTracker.counterStartTime = getTimeMilliseconds(); 
+	timeTracker.counterStartTime = getTimeNanoseconds(); 
 
 	int increment = 37, decrement = 36;
 	unsigned long i = 0, temp;
@@ -144,21 +262,43 @@ void incrementCounter(unsigned long numIncs) {
         i = i + 1;
     } while (i < numIncs);
 	
-	timeTracker.counterElapsedTime = getTimeMilliseconds() - timeTracker.counterStartTime;
+	timeTracker.counterElapsedTime = getTimeNanoseconds() - timeTracker.counterStartTime;
 }
 
 // Reads a file and replicates its contents "numberOfOutputFiles" times inside a directory 
 void replicateFile(int directoryNumber) {
-	timeTracker.fileStartTime = getTimeMilliseconds(); 
+	timeTracker.fileStartTime = getTimeNanoseconds(); 
 	
 	char *outFile;
 	FILE *inFileHandle, *outFileHandle;
     size_t readSize, fileSize;
+	uint64_t readStartTime, writeStartTime, readElapsedTime = 0, writeElapsedTime = 0;
 	
+    // In-kernel backends copy without going through a user space buffer
+	if (copyBackend != COPY_STDIO) {
+		copyBackend = replicateFileWithBackend(copyBackend, inFileName, outFileName, directoryNumber, 0, numberOfOutputFiles);
+		timeTracker.fileReadElapsedTime = 0;
+		timeTracker.fileWriteElapsedTime = 0;
+		timeTracker.fileElapsedTime = getTimeNanoseconds() - timeTracker.fileStartTime;
+		return;
+	}
+	
+    // Writes every output straight from the input loaded at startup
+	if (sourceFile.data != NULL) {
+		writeStartTime = getTimeNanoseconds();
+		replicateFileFromSource(&sourceFile, outFileName, directoryNumber, 0, numberOfOutputFiles);
+		timeTracker.fileReadElapsedTime = 0;
+		timeTracker.fileWriteElapsedTime = getTimeNanoseconds() - writeStartTime;
+		timeTracker.fileElapsedTime = getTimeNanoseconds() - timeTracker.fileStartTime;
+		return;
+	}
+	
+    readStartTime = getTimeNanoseconds();
     inFileHandle = fopen(inFileName, "r");
     fseek(inFileHandle, 0, SEEK_END);
     fileSize = ftell(inFileHandle);
     rewind(inFileHandle);
+    readElapsedTime += getTimeNanoseconds() - readStartTime;
 
     char *buffer = (char *)malloc(fileSize);
 
@@ -166,27 +306,39 @@ void replicateFile(int directoryNumber) {
 	for (i = 0; i < numberOfOutputFiles; i++) {
 		outFile = (char *)malloc(sizeof(outFileName) + 20);
 		sprintf((char *)outFile, outFileName, directoryNumber, i);
+		writeStartTime = getTimeNanoseconds();
 		outFileHandle = fopen(outFile, "w");
+		writeElapsedTime += getTimeNanoseconds() - writeStartTime;
 		while (1) {
+            readStartTime = getTimeNanoseconds();
             readSize = fread(buffer, 1, fileSize, inFileHandle);
+            readElapsedTime += getTimeNanoseconds() - readStartTime;
 			
 			if (readSize > 0) {
+				writeStartTime = getTimeNanoseconds();
 				fwrite(buffer, 1, fileSize, outFileHandle);
+				writeElapsedTime += getTimeNanoseconds() - writeStartTime;
 			} else {
 				break;
 			}
 		}
 		
+		writeStartTime = getTimeNanoseconds();
 		fclose(outFileHandle);
+		writeElapsedTime += getTimeNanoseconds() - writeStartTime;
 		free(outFile);
 		outFile = NULL;
+        readStartTime = getTimeNanoseconds();
         rewind(inFileHandle);
+        readElapsedTime += getTimeNanoseconds() - readStartTime;
 	}
 	
 	fclose(inFileHandle);
     free(buffer);
 	
-	timeTracker.fileElapsedTime = getTimeMilliseconds() - timeTracker.fileStartTime;
+	timeTracker.fileReadElapsedTime = readElapsedTime;
+	timeTracker.fileWriteElapsedTime = writeElapsedTime;
+	timeTracker.fileElapsedTime = getTimeNanoseconds() - timeTracker.fileStartTime;
 }
 
 // Produces/calculates the results of the equation
@@ -196,6 +348,26 @@ void ProduceEquationResults(int i) {
 	cord.y += i * 1.1;
 }
 
+/* Vector counterpart of ProduceEquationResults(). Evaluates the equation EQUATION_BATCH_SIZE points at a time with the selected
+ * kernel, then hands the points one by one to ConsumeEquationResults() exactly as ProduceEquationResults() would have left them in "cord".
+ */
+void CalculateEquationBatches() {
+	EquationBatch batch;
+	int i, j, count;
+	
+	for (i = 0; i < cord.qtdPointsToCalculate; i += count) {
+		count = cord.qtdPointsToCalculate - i < EQUATION_BATCH_SIZE ? cord.qtdPointsToCalculate - i : EQUATION_BATCH_SIZE;
+		computeEquationBatch(evaluateEquation, &batch, cord.x, cord.y, i, count);
+		
+		for (j = 0; j < count; j++) {
+			cord.x = batch.x[j + 1];
+			cord.y = batch.y[j + 1];
+			cord.z = batch.z[j];
+			ConsumeEquationResults();
+		}
+	}
+}
+
 // Consumes the result of the calculation of the equation. 
 void ConsumeEquationResults() {
     double x, y, z;
@@ -205,14 +377,59 @@ void ConsumeEquationResults() {
     z = cord.z;
 }
 
-double getTimeMilliseconds() {
-	struct timeval tv;
-	struct timezone tz;
-
-    gettimeofday(&tv, &tz);
-    double milliseconds = tv.tv_sec * 1000 + (double)tv.tv_usec / 1000.0f;
-
-//    printf("seconds: %ld, microseconds: %d, milliseconds: %.3f\n", tv.tv_sec, tv.tv_usec, milliseconds);
-
-    return milliseconds;
+/* Reads the command line options. Returns non-zero if an option is not recognized.
+ *   -kernel scalar|sse|avx2|auto                                  Selects how the equation is evaluated ("auto" picks the widest supported)
+ *   -copy stdio|ficlone|copy_file_range|sendfile|readwrite|uring  Selects how the file is replicated
+ *   -uring-depth N                                                Submissions in flight with "-copy uring"
+ *   -source reread|cache|mmap                                     Reads the input for every output file, or loads it once
+ *   -clock monotonic|tsc                                          Selects the clock behind every time measurement
+ *   -warmup N                                                     Leaves the first N iterations out of the summary (default 5)
+ *   -ci-width X                                                   Stops once every confidence interval is narrower than X times its mean
+ *   -perf                                                         Adds the hardware counters of every phase (cycles, instructions, misses, ...)
+ *   -config FILE                                                  Reads "name = value" workload settings from FILE
+ *   -replay FILE                                                  Repeats a run with the settings recorded in its log, Posix.Linear.csv
+ *   -iterations N, -output-files N, -equation-points N, -counter-increments N
+ *                                                                 Workload sizes (default 100, 100, 200000, 100000000)
+ *   -input FILE, -output-root DIRECTORY                           File replicated on every iteration (default gpl.txt), and where its copies go
+ */
+int parseArguments(int argc, char *argv[]) {
+	int i;
+	
+	for (i = 1; i < argc; i++) {
+		if (strcmp(argv[i], "-kernel") == 0 && i + 1 < argc && parseEquationKernel(argv[i + 1], &equationKernel) == 0) {
+			i++;
+		} else if (strcmp(argv[i], "-copy") == 0 && i + 1 < argc && parseCopyBackend(argv[i + 1], &copyBackend) == 0) {
+			i++;
+		} else if (strcmp(argv[i], "-source") == 0 && i + 1 < argc && parseSourceMode(argv[i + 1], &sourceMode) == 0) {
+			i++;
+		} else if (strcmp(argv[i], "-clock") == 0 && i + 1 < argc && parseClockSource(argv[i + 1], &clockSource) == 0) {
+			i++;
+		} else if (strcmp(argv[i], "-warmup") == 0 && i + 1 < argc && atoi(argv[i + 1]) >= 0) {
+			warmupIterations = atoi(argv[++i]);
+		} else if (strcmp(argv[i], "-ci-width") == 0 && i + 1 < argc && atof(argv[i + 1]) > 0) {
+			confidenceWidth = atof(argv[++i]);
+		} else if (strcmp(argv[i], "-perf") == 0) {
+			measurePerf = 1;
+		} else if (strcmp(argv[i], "-config") == 0 && i + 1 < argc) {
+			if (loadConfigFile(settings, NUMBER_OF_SETTINGS, argv[++i]) != 0) {
+				return 1;
+			}
+		} else if (strcmp(argv[i], "-replay") == 0 && i + 1 < argc) {
+			if (loadRunLog(settings, NUMBER_OF_SETTINGS, argv[++i]) != 0) {
+				return 1;
+			}
+		} else if (argv[i][0] == '-' && i + 1 < argc && applySetting(settings, NUMBER_OF_SETTINGS, argv[i] + 1, argv[i + 1]) == 0) {
+			i++;
+		} else if (strcmp(argv[i], "-uring-depth") == 0 && i + 1 < argc && atoi(argv[i + 1]) > 0) {
+			setCopyQueueDepth(atoi(argv[++i]));
+		} else {
+			fprintf(stderr, "Usage: %s [-kernel scalar|sse|avx2|auto] [-copy stdio|ficlone|copy_file_range|sendfile|readwrite|uring]\n"
+					"       [-uring-depth N] [-source reread|cache|mmap] [-clock monotonic|tsc]\n"
+					"       [-perf] [-warmup N] [-ci-width X] [-config FILE] [-replay FILE] [-iterations N] [-output-files N] [-equation-points N]\n"
+					"       [-counter-increments N] [-input FILE] [-output-root DIRECTORY]\n", argv[0]);
+			return 1;
+		}
+	}
+	
+	return 0;
 }
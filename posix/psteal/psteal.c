@@ -0,0 +1,692 @@
+/*
+    psteal.c
+    Copyright (C) 2010 Dalmo Cirne
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdatomic.h>
+#include <math.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include "../common/equation.h"
+#include "../common/filecopy.h"
+#include "../common/timing.h"
+#include "../common/stats.h"
+#include "../common/config.h"
+#include "../common/affinity.h"
+
+#define OUT_FILE_FORMAT "outfiles%d/gpl.%d.txt"
+#define DIR_FORMAT "outfiles%d"
+#define PATH_SIZE 4096
+#define NUMBER_OF_SETTINGS (int)(sizeof(settings) / sizeof(Setting))
+#define SCREENING 1
+#define CACHE_LINE_SIZE 64
+// Keeps the compiler from folding a counting loop into a single add: every step loads and stores the counter
+#define COUNTER_STEP_BARRIER() __asm__ __volatile__("" ::: "memory")
+#define DEQUE_CAPACITY 1024 // Power of two. Splitting in halves keeps a deque about log2(work / grain) deep
+
+// Time tracker structure. Holds all time measurements relevant to this experiment, in nanoseconds.
+typedef struct {
+	uint64_t startTime, elapsedTime;
+	uint64_t iteractionStartTime, iteractionElapsedTime;
+	uint64_t counterElapsedTime, equationElapsedTime, fileElapsedTime;
+} TimeTracker;
+
+// The three workloads of the experiment, each one a tree of tasks
+typedef enum {
+	TASK_COUNTER,  // Increments of the counter
+	TASK_EQUATION, // Points of the equation
+	TASK_FILE,     // Copies of the input file
+	TASK_KINDS
+} TaskKind;
+
+/* Range of work of one kind: counter increments, equation points or output files. A task larger than the grain of
+ * its kind gives away its upper half to the deque of the worker running it, until what is left fits the grain.
+ */
+typedef struct {
+	TaskKind kind;
+	long first, count;
+} Task;
+
+/* Chase-Lev work-stealing deque. The owner pushes and pops at the bottom, thieves take from the top; only a pop of the
+ * last task races with the thieves, and the race is settled by a compare-and-swap on top. Top and bottom live on
+ * separate cache lines.
+ */
+typedef struct {
+	atomic_long top;
+	char padTop[CACHE_LINE_SIZE - sizeof(atomic_long)];
+	atomic_long bottom;
+	char padBottom[CACHE_LINE_SIZE - sizeof(atomic_long)];
+	Task *_Atomic slots[DEQUE_CAPACITY];
+} WorkDeque;
+
+// State of a worker thread. Its share of the counter and of the equation sum are added up after every iteration
+typedef struct {
+	WorkDeque deque;
+	unsigned long counter;
+	double equationSum;
+	unsigned long tasks, steals;
+	unsigned int seed; // Picks the victims of steals
+	char pad[CACHE_LINE_SIZE];
+} Worker;
+
+/* Workers are created once and wait for the generation number to change; each change starts one iteration from the
+ * root task of every kind. The iteration is complete once no task of any kind is pending and every worker is idle.
+ */
+typedef struct {
+	pthread_mutex_t mtx;
+	pthread_cond_t condDispatch, condComplete;
+	unsigned long generation;
+	int idle;
+	int shutdown;
+	Task roots[TASK_KINDS];
+	atomic_int nextRoot;
+	atomic_long pending[TASK_KINDS]; // Tasks of each kind pushed or running, and not finished yet
+	atomic_int kindsRemaining;       // Kinds with pending tasks
+	Task *tasks;                     // Halves given away during the iteration
+	long capacity;
+	atomic_long nextTask;
+} Scheduler;
+
+TimeTracker timeTracker;
+Worker *workers;
+Scheduler scheduler = {PTHREAD_MUTEX_INITIALIZER, PTHREAD_COND_INITIALIZER, PTHREAD_COND_INITIALIZER, 0, 0, 0};
+atomic_ullong phaseStartTime[TASK_KINDS];
+uint64_t phaseElapsedTime[TASK_KINDS];
+
+// Global variables
+int numberIteractions = 100;
+int numberOfOutputFiles = 100;
+int numberOfEquationPoints = 200000;
+unsigned long numberOfCounterIncrements = 100000000;
+int numberOfWorkers = 0;
+unsigned long counterGrain = 1000000;
+int equationGrain = 2048;
+int fileGrain = 1;
+char *inFileName = "gpl.txt";
+char *outputRoot = ".";
+char outFileName[PATH_SIZE], dirName[PATH_SIZE];
+
+// Workload settings, given as "-name value" on the command line or as "name = value" in a "-config" file
+const Setting settings[] = {
+	{"iterations", SETTING_INT, &numberIteractions},
+	{"output-files", SETTING_INT, &numberOfOutputFiles},
+	{"equation-points", SETTING_INT, &numberOfEquationPoints},
+	{"counter-increments", SETTING_ULONG, &numberOfCounterIncrements},
+	{"workers", SETTING_INT, &numberOfWorkers},
+	{"counter-grain", SETTING_ULONG, &counterGrain},
+	{"equation-grain", SETTING_INT, &equationGrain},
+	{"file-grain", SETTING_INT, &fileGrain},
+	{"input", SETTING_STRING, &inFileName},
+	{"output-root", SETTING_STRING, &outputRoot}
+};
+int dirNumber;
+EquationKernel equationKernel = KERNEL_SCALAR;
+EquationBatchFunction evaluateEquation;
+CopyBackend copyBackend = COPY_STDIO;
+ClockSource clockSource = CLOCK_SOURCE_MONOTONIC;
+char *placement = "none";
+int warmupIterations = 5;
+double confidenceWidth = 0;
+const char *const SummaryColumns[] = {"Counter Time", "Equation Time", "File Time", "Iteration Time"};
+SourceMode sourceMode = SOURCE_REREAD;
+SourceFile sourceFile;
+char *const FileName = "Posix.Steal.csv";
+char *const SummaryFileName = "Posix.Steal.Summary.csv";
+
+// Posix mutexes
+pthread_mutex_t mtxCopyBackend = PTHREAD_MUTEX_INITIALIZER;
+
+// Prototypes of functions executed by threads
+void *runWorker(void *workerIndex);
+
+// Prototypes of functions using or used by the threads
+int pushTask(WorkDeque *deque, Task *task);
+Task *popTask(WorkDeque *deque);
+Task *stealTask(WorkDeque *deque);
+Task *findTask(int workerIndex);
+void runTask(Worker *worker, Task *task);
+void finishTask(TaskKind kind);
+void incrementCounter(Worker *worker, long increments);
+void replicateFile(long firstFile, long numberOfFiles);
+void dispatchIteration();
+void waitIteration();
+int parseArguments(int argc, char *argv[]);
+
+/* Executes the experiment 'numberIteractions' times. On each cycle integer, floating point, and I/O operations
+ * are performed, split into tasks shared by a fixed set of workers.
+ */
+int main(int argc, char *argv[]) {
+	// Declaration of variables
+	if (parseArguments(argc, argv) != 0) {
+		return 1;
+	}
+	clockSource = initTiming(clockSource);
+	if (numberOfWorkers == 0) {
+		numberOfWorkers = sysconf(_SC_NPROCESSORS_ONLN);
+	}
+	if (initPlacement(placement) != 0) {
+		fprintf(stderr, "Placement %s is not valid on this machine\n", placement);
+		return 1;
+	}
+
+	// Output directories and files are created under "outputRoot"
+	buildOutputFormat(outFileName, sizeof(outFileName), outputRoot, OUT_FILE_FORMAT);
+	buildOutputFormat(dirName, sizeof(dirName), outputRoot, DIR_FORMAT);
+	mkdir(outputRoot, S_IRWXU | S_IRGRP | S_IXGRP | S_IROTH | S_IXOTH);
+
+	// Starts counting time, once the clock is calibrated
+	timeTracker.startTime = getTimeNanoseconds();
+
+	pthread_t threads[numberOfWorkers];
+	pthread_attr_t attr;
+	double equationSum, expectedEquationSum;
+	unsigned long counter, tasks, steals;
+	char *dName;
+	FILE *fp;
+	uint64_t currentTime;
+
+	equationKernel = selectEquationKernel(equationKernel, numberOfEquationPoints);
+	evaluateEquation = getEquationBatchFunction(equationKernel);
+	expectedEquationSum = evaluateEquationSequence(evaluateEquation, numberOfEquationPoints);
+	if (copyBackend != COPY_STDIO) {
+		printf("File backend: %s\n", getCopyBackendName(copyBackend));
+	}
+
+	// The input file can be loaded once and shared by every iteration instead of being read again for every output
+	if (sourceMode != SOURCE_REREAD) {
+		currentTime = getTimeNanoseconds();
+		if (loadSourceFile(inFileName, sourceMode, &sourceFile) != 0) {
+			fprintf(stderr, "Could not load %s, reading it on every iteration\n", inFileName);
+		}
+		printf("Source file loaded once in %.3f\n", toMilliseconds(getTimeNanoseconds() - currentTime));
+	}
+
+	if (posix_memalign((void **)&workers, CACHE_LINE_SIZE, numberOfWorkers * sizeof(Worker)) != 0) {
+		fprintf(stderr, "Could not allocate %d workers\n", numberOfWorkers);
+		return 1;
+	}
+
+	// Creates file to host the experiment's log
+	fp = fopen(FileName, "w");
+	writeSettings(fp, settings, NUMBER_OF_SETTINGS);
+	writeCommandLine(fp, argc, argv);
+	fprintf(fp, "# kernel = %s\n", getEquationKernelName(equationKernel));
+	writePlacement(fp, numberOfWorkers);
+	#if SCREENING == 1
+		writePlacement(stdout, numberOfWorkers);
+	#endif
+	fprintf(fp, "Elapsed Time, Iteration Time, Counter Time, Equation Time, File Time, Tasks, Steals\n");
+
+	// The root tasks cover the whole workload (see dispatchIteration()); every half given away is taken from
+	// "scheduler.tasks", which is sized for splitting each root all the way down to its grain
+	scheduler.roots[TASK_COUNTER].kind = TASK_COUNTER;
+	scheduler.roots[TASK_EQUATION].kind = TASK_EQUATION;
+	scheduler.roots[TASK_FILE].kind = TASK_FILE;
+	scheduler.capacity = 2 * (numberOfCounterIncrements / counterGrain + numberOfEquationPoints / equationGrain +
+			numberOfOutputFiles / fileGrain) + TASK_KINDS;
+	scheduler.tasks = (Task *)malloc(scheduler.capacity * sizeof(Task));
+
+	// Creates the workers once; they are reused by every iteration
+	int iteraction, i;
+	memset(workers, 0, numberOfWorkers * sizeof(Worker));
+	pthread_attr_init(&attr);
+	pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_JOINABLE);
+	for (i = 0; i < numberOfWorkers; i++) {
+		workers[i].seed = i + 1;
+		setThreadPlacement(&attr, i);
+		pthread_create(&threads[i], &attr, runWorker, (void *)(long)i);
+	}
+
+	// Loops "numberIteractions" times to generate enough statistical data for analysis
+	SampleTable samples;
+	double sampleRow[4];
+	initSampleTable(&samples, SummaryColumns, 4, numberIteractions);
+	for (iteraction = 0; iteraction < numberIteractions; iteraction++) {
+		timeTracker.iteractionStartTime = getTimeNanoseconds();
+
+		dName = malloc(sizeof(dirName) + 4);
+		sprintf((char *)dName, dirName, iteraction);
+		mkdir((char *)dName, S_IRWXU | S_IRGRP | S_IROTH);
+		free(dName);
+		dName = NULL;
+		dirNumber = iteraction;
+
+        // Starts the root tasks and waits for every task they spawn to complete
+		dispatchIteration();
+		waitIteration();
+
+		counter = 0;
+		equationSum = 0;
+		tasks = 0;
+		steals = 0;
+		for (i = 0; i < numberOfWorkers; i++) {
+			counter += workers[i].counter;
+			equationSum += workers[i].equationSum;
+			tasks += workers[i].tasks;
+			steals += workers[i].steals;
+		}
+		if (counter != numberOfCounterIncrements) {
+			fprintf(stderr, "Iteration %d: counter is %lu, expected %lu\n", iteraction, counter, numberOfCounterIncrements);
+		}
+		if (fabs(equationSum - expectedEquationSum) > getEquationSequenceTolerance(numberOfEquationPoints) * fabs(expectedEquationSum)) {
+			fprintf(stderr, "Iteration %d: equation sum is %.9f, expected %.9f\n", iteraction, equationSum, expectedEquationSum);
+		}
+		timeTracker.counterElapsedTime = phaseElapsedTime[TASK_COUNTER];
+		timeTracker.equationElapsedTime = phaseElapsedTime[TASK_EQUATION];
+		timeTracker.fileElapsedTime = phaseElapsedTime[TASK_FILE];
+
+        // Saves result of the current iteration on the log file
+		currentTime = getTimeNanoseconds();
+		timeTracker.iteractionElapsedTime = currentTime - timeTracker.iteractionStartTime;
+		timeTracker.elapsedTime = currentTime - timeTracker.startTime;
+		fprintf(fp, "%.3f, %.3f, %.3f, %.3f, %.3f, %lu, %lu\n", toMilliseconds(timeTracker.elapsedTime),
+				toMilliseconds(timeTracker.iteractionElapsedTime), toMilliseconds(timeTracker.counterElapsedTime),
+				toMilliseconds(timeTracker.equationElapsedTime), toMilliseconds(timeTracker.fileElapsedTime), tasks, steals);
+
+        // If running on screening mode, also show the results on the screen
+		#if SCREENING == 1
+			printf("%d -> %.3f, %.3f, %.3f, %.3f, %.3f, %lu, %lu\n", iteraction, toMilliseconds(timeTracker.elapsedTime),
+                   toMilliseconds(timeTracker.iteractionElapsedTime), toMilliseconds(timeTracker.counterElapsedTime),
+                   toMilliseconds(timeTracker.equationElapsedTime), toMilliseconds(timeTracker.fileElapsedTime), tasks, steals);
+		#endif
+
+		// Stops once every phase is measured precisely enough, without waiting for the remaining iterations
+		sampleRow[0] = toMilliseconds(timeTracker.counterElapsedTime);
+		sampleRow[1] = toMilliseconds(timeTracker.equationElapsedTime);
+		sampleRow[2] = toMilliseconds(timeTracker.fileElapsedTime);
+		sampleRow[3] = toMilliseconds(timeTracker.iteractionElapsedTime);
+		addSampleRow(&samples, sampleRow);
+		if (confidenceWidth > 0 && isConfidenceReached(&samples, warmupIterations, confidenceWidth)) {
+			printf("Confidence interval within %.3f of the mean after %d iterations, stopping\n", confidenceWidth, iteraction + 1);
+			break;
+		}
+	}
+
+	fclose(fp); // Closes experiment's log file
+	writeSampleSummary(&samples, warmupIterations, SummaryFileName);
+	freeSampleTable(&samples);
+	releaseSourceFile(&sourceFile);
+
+    // Releases the workers
+	pthread_mutex_lock(&scheduler.mtx);
+	scheduler.shutdown = 1;
+	pthread_cond_broadcast(&scheduler.condDispatch);
+	pthread_mutex_unlock(&scheduler.mtx);
+	for (i = 0; i < numberOfWorkers; i++) {
+		pthread_join(threads[i], NULL);
+	}
+
+    // Frees mutexes and thread attributes
+	pthread_cond_destroy(&scheduler.condDispatch);
+	pthread_cond_destroy(&scheduler.condComplete);
+	pthread_mutex_destroy(&scheduler.mtx);
+	pthread_attr_destroy(&attr);
+	free(scheduler.tasks);
+	free(workers);
+	pthread_exit(NULL);
+}
+
+/* Body of every worker. On each iteration the workers first claim the root tasks, then keep running tasks from their
+ * own deque, or stolen from the deques of the others, until no task of any kind is pending.
+ */
+void *runWorker(void *workerIndex) {
+	int index = (int)(long)workerIndex, root;
+	Worker *worker = &workers[index];
+	unsigned long lastGeneration = 0;
+	Task *task;
+
+	pthread_mutex_lock(&scheduler.mtx);
+	while (1) {
+		scheduler.idle++;
+		if (scheduler.idle == numberOfWorkers) {
+			pthread_cond_signal(&scheduler.condComplete);
+		}
+		while (scheduler.generation == lastGeneration && !scheduler.shutdown) {
+			pthread_cond_wait(&scheduler.condDispatch, &scheduler.mtx);
+		}
+
+		if (scheduler.shutdown) {
+			break;
+		}
+
+		lastGeneration = scheduler.generation;
+		pthread_mutex_unlock(&scheduler.mtx);
+
+		while ((root = atomic_fetch_add(&scheduler.nextRoot, 1)) < TASK_KINDS) {
+			runTask(worker, &scheduler.roots[root]);
+		}
+		while (atomic_load(&scheduler.kindsRemaining) > 0) {
+			task = findTask(index);
+			if (task != NULL) {
+				runTask(worker, task);
+			} else {
+				sched_yield();
+			}
+		}
+
+		pthread_mutex_lock(&scheduler.mtx);
+	}
+	pthread_mutex_unlock(&scheduler.mtx);
+
+	return NULL;
+}
+
+// Takes the next task of the worker's own deque or, when it is empty, steals one from a randomly chosen worker
+Task *findTask(int workerIndex) {
+	Worker *worker = &workers[workerIndex];
+	Task *task;
+	int attempt, victim;
+
+	task = popTask(&worker->deque);
+	for (attempt = 0; task == NULL && attempt < numberOfWorkers - 1; attempt++) {
+		victim = rand_r(&worker->seed) % (numberOfWorkers - 1);
+		victim = victim >= workerIndex ? victim + 1 : victim;
+		task = stealTask(&workers[victim].deque);
+		if (task != NULL) {
+			worker->steals++;
+		}
+	}
+
+	return task;
+}
+
+/* Runs a task. While it is larger than its grain it gives away its upper half, so idle workers can steal it; then it
+ * performs what is left. Counter increments go to the worker's own share, as on "-counter sharded" in pstress.
+ */
+void runTask(Worker *worker, Task *task) {
+	unsigned long long zero = 0;
+	long grains[TASK_KINDS] = {counterGrain, equationGrain, fileGrain};
+	long taskIndex;
+	Task *half;
+
+	atomic_compare_exchange_strong(&phaseStartTime[task->kind], &zero, getTimeNanoseconds());
+
+	while (task->count > grains[task->kind] && (taskIndex = atomic_fetch_add(&scheduler.nextTask, 1)) < scheduler.capacity) {
+		half = &scheduler.tasks[taskIndex];
+		half->kind = task->kind;
+		half->count = task->count / 2;
+		half->first = task->first + task->count - half->count;
+
+		// Counted as pending before it can be stolen, so its kind is never seen as finished too early
+		atomic_fetch_add(&scheduler.pending[task->kind], 1);
+		if (!pushTask(&worker->deque, half)) {
+			atomic_fetch_sub(&scheduler.pending[task->kind], 1);
+			break;
+		}
+		task->count -= half->count;
+	}
+
+	switch (task->kind) {
+		case TASK_COUNTER:
+			incrementCounter(worker, task->count);
+			break;
+		case TASK_EQUATION:
+			worker->equationSum += evaluateEquationRange(evaluateEquation, task->first, task->count);
+			break;
+		default:
+			replicateFile(task->first, task->count);
+			break;
+	}
+	worker->tasks++;
+
+	finishTask(task->kind);
+}
+
+// Marks a task as finished. The last task of a kind records the time of the whole kind
+void finishTask(TaskKind kind) {
+	if (atomic_fetch_sub(&scheduler.pending[kind], 1) == 1) {
+		phaseElapsedTime[kind] = getTimeNanoseconds() - atomic_load(&phaseStartTime[kind]);
+		atomic_fetch_sub(&scheduler.kindsRemaining, 1);
+	}
+}
+
+// Increments the worker's share of the counter "increments" times
+void incrementCounter(Worker *worker, long increments) {
+	int increment = 37, decrement = 36;
+	unsigned long temp;
+	long i = 0;
+
+    do {
+		temp = worker->counter;
+		temp = temp + increment;
+		temp = temp - decrement;
+		worker->counter = temp;
+		COUNTER_STEP_BARRIER();
+        i = i + 1;
+    } while (i < increments);
+}
+
+/* Replicates the input file into "numberOfFiles" output files, starting at "firstFile". Files are read and written
+ * the same way as the file writers of pstress.
+ */
+void replicateFile(long firstFile, long numberOfFiles) {
+	char *outFile, *buffer;
+	FILE *inFileHandle, *outFileHandle;
+    size_t fileSize;
+	CopyBackend backend;
+	long i;
+
+	pthread_mutex_lock(&mtxCopyBackend);
+	backend = copyBackend;
+	pthread_mutex_unlock(&mtxCopyBackend);
+
+    // In-kernel backends copy without going through a user space buffer. A fallback is kept for the next tasks
+	if (backend != COPY_STDIO) {
+		backend = replicateFileWithBackend(backend, inFileName, outFileName, dirNumber, firstFile, numberOfFiles);
+		pthread_mutex_lock(&mtxCopyBackend);
+		copyBackend = backend;
+		pthread_mutex_unlock(&mtxCopyBackend);
+		return;
+	}
+
+    // Writes every output straight from the input loaded at startup
+	if (sourceFile.data != NULL) {
+		replicateFileFromSource(&sourceFile, outFileName, dirNumber, firstFile, numberOfFiles);
+		return;
+	}
+
+    inFileHandle = fopen(inFileName, "r");
+    fseek(inFileHandle, 0, SEEK_END);
+    fileSize = ftell(inFileHandle);
+    rewind(inFileHandle);
+    buffer = (char *)allocateLocalBuffer(fileSize);
+	outFile = (char *)malloc(sizeof(outFileName) + 20);
+
+	for (i = firstFile; i < firstFile + numberOfFiles; i++) {
+		sprintf(outFile, outFileName, dirNumber, (int)i);
+		outFileHandle = fopen(outFile, "w");
+		while (fread(buffer, 1, fileSize, inFileHandle) > 0) {
+			fwrite(buffer, 1, fileSize, outFileHandle);
+		}
+		fclose(outFileHandle);
+        rewind(inFileHandle);
+	}
+
+	free(outFile);
+	fclose(inFileHandle);
+    releaseLocalBuffer(buffer, fileSize);
+}
+
+// Pushes a task at the bottom of the deque. Only called by the owner. Returns 0 if the deque is full
+int pushTask(WorkDeque *deque, Task *task) {
+	long bottom = atomic_load_explicit(&deque->bottom, memory_order_relaxed);
+	long top = atomic_load_explicit(&deque->top, memory_order_acquire);
+
+	if (bottom - top >= DEQUE_CAPACITY) {
+		return 0;
+	}
+
+	atomic_store_explicit(&deque->slots[bottom & (DEQUE_CAPACITY - 1)], task, memory_order_relaxed);
+	atomic_thread_fence(memory_order_release);
+	atomic_store_explicit(&deque->bottom, bottom + 1, memory_order_relaxed);
+
+	return 1;
+}
+
+// Pops the task at the bottom of the deque. Only called by the owner. Returns NULL if the deque is empty
+Task *popTask(WorkDeque *deque) {
+	long bottom = atomic_load_explicit(&deque->bottom, memory_order_relaxed) - 1;
+	long top;
+	Task *task = NULL;
+
+	atomic_store_explicit(&deque->bottom, bottom, memory_order_relaxed);
+	atomic_thread_fence(memory_order_seq_cst);
+	top = atomic_load_explicit(&deque->top, memory_order_relaxed);
+
+	if (top <= bottom) {
+		task = atomic_load_explicit(&deque->slots[bottom & (DEQUE_CAPACITY - 1)], memory_order_relaxed);
+		if (top == bottom) {
+			// Last task: a thief may be taking it at the same time
+			if (!atomic_compare_exchange_strong_explicit(&deque->top, &top, top + 1, memory_order_seq_cst, memory_order_relaxed)) {
+				task = NULL;
+			}
+			atomic_store_explicit(&deque->bottom, bottom + 1, memory_order_relaxed);
+		}
+	} else {
+		atomic_store_explicit(&deque->bottom, bottom + 1, memory_order_relaxed);
+	}
+
+	return task;
+}
+
+// Steals the task at the top of the deque. Called by any other worker. Returns NULL if it is empty or the race was lost
+Task *stealTask(WorkDeque *deque) {
+	long top = atomic_load_explicit(&deque->top, memory_order_acquire);
+	long bottom;
+	Task *task;
+
+	atomic_thread_fence(memory_order_seq_cst);
+	bottom = atomic_load_explicit(&deque->bottom, memory_order_acquire);
+
+	if (top >= bottom) {
+		return NULL;
+	}
+
+	task = atomic_load_explicit(&deque->slots[top & (DEQUE_CAPACITY - 1)], memory_order_relaxed);
+	if (!atomic_compare_exchange_strong_explicit(&deque->top, &top, top + 1, memory_order_seq_cst, memory_order_relaxed)) {
+		return NULL;
+	}
+
+	return task;
+}
+
+// Resets the state of an iteration and wakes the workers. The workers are all idle, waiting for the generation to change
+void dispatchIteration() {
+	int kind, i;
+
+	pthread_mutex_lock(&scheduler.mtx);
+	while (scheduler.idle < numberOfWorkers) {
+		pthread_cond_wait(&scheduler.condComplete, &scheduler.mtx);
+	}
+
+	for (i = 0; i < numberOfWorkers; i++) {
+		workers[i].counter = 0;
+		workers[i].equationSum = 0;
+		workers[i].tasks = 0;
+		workers[i].steals = 0;
+	}
+	for (kind = 0; kind < TASK_KINDS; kind++) {
+		scheduler.roots[kind].first = 0;
+		atomic_store(&scheduler.pending[kind], 1);
+		atomic_store(&phaseStartTime[kind], 0);
+		phaseElapsedTime[kind] = 0;
+	}
+	scheduler.roots[TASK_COUNTER].count = numberOfCounterIncrements;
+	scheduler.roots[TASK_EQUATION].count = numberOfEquationPoints;
+	scheduler.roots[TASK_FILE].count = numberOfOutputFiles;
+	atomic_store(&scheduler.nextRoot, 0);
+	atomic_store(&scheduler.nextTask, 0);
+	atomic_store(&scheduler.kindsRemaining, TASK_KINDS);
+
+	scheduler.idle = 0;
+	scheduler.generation++;
+	pthread_cond_broadcast(&scheduler.condDispatch);
+	pthread_mutex_unlock(&scheduler.mtx);
+}
+
+// Waits until every worker has gone idle, which only happens once every task of the iteration has finished
+void waitIteration() {
+	pthread_mutex_lock(&scheduler.mtx);
+	while (scheduler.idle < numberOfWorkers) {
+		pthread_cond_wait(&scheduler.condComplete, &scheduler.mtx);
+	}
+	pthread_mutex_unlock(&scheduler.mtx);
+}
+
+/* Reads the command line options. Returns non-zero if an option is not recognized.
+ *   -kernel scalar|sse|avx2|auto                                  Selects how the equation is evaluated ("auto" picks the widest supported)
+ *   -copy stdio|ficlone|copy_file_range|sendfile|readwrite|uring  Selects how the file is replicated
+ *   -uring-depth N                                                Submissions in flight with "-copy uring"
+ *   -source reread|cache|mmap                                     Reads the input for every output file, or loads it once
+ *   -clock monotonic|tsc                                          Selects the clock behind every time measurement
+ *   -warmup N                                                     Leaves the first N iterations out of the summary (default 5)
+ *   -ci-width X                                                   Stops once every confidence interval is narrower than X times its mean
+ *   -config FILE                                                  Reads "name = value" workload settings from FILE
+ *   -replay FILE                                                  Repeats a run with the settings recorded in its log, Posix.Steal.csv
+ *   -iterations N, -output-files N, -equation-points N, -counter-increments N
+ *                                                                 Workload sizes (default 100, 100, 200000, 100000000)
+ *   -workers N                                                    Worker threads (default the number of processors)
+ *   -counter-grain N, -equation-grain N, -file-grain N            Largest task that is not split (default 1000000, 2048, 1)
+ *   -input FILE, -output-root DIRECTORY                           File replicated on every iteration (default gpl.txt), and where its copies go
+ *   -affinity none|compact|scatter|node|node:N|LIST               Pins the workers; LIST is a processor list such as "0,2,8-11"
+ */
+int parseArguments(int argc, char *argv[]) {
+	int i;
+
+	for (i = 1; i < argc; i++) {
+		if (strcmp(argv[i], "-kernel") == 0 && i + 1 < argc && parseEquationKernel(argv[i + 1], &equationKernel) == 0) {
+			i++;
+		} else if (strcmp(argv[i], "-copy") == 0 && i + 1 < argc && parseCopyBackend(argv[i + 1], &copyBackend) == 0) {
+			i++;
+		} else if (strcmp(argv[i], "-source") == 0 && i + 1 < argc && parseSourceMode(argv[i + 1], &sourceMode) == 0) {
+			i++;
+		} else if (strcmp(argv[i], "-clock") == 0 && i + 1 < argc && parseClockSource(argv[i + 1], &clockSource) == 0) {
+			i++;
+		} else if (strcmp(argv[i], "-warmup") == 0 && i + 1 < argc && atoi(argv[i + 1]) >= 0) {
+			warmupIterations = atoi(argv[++i]);
+		} else if (strcmp(argv[i], "-ci-width") == 0 && i + 1 < argc && atof(argv[i + 1]) > 0) {
+			confidenceWidth = atof(argv[++i]);
+		} else if (strcmp(argv[i], "-affinity") == 0 && i + 1 < argc) {
+			placement = argv[++i];
+		} else if (strcmp(argv[i], "-config") == 0 && i + 1 < argc) {
+			if (loadConfigFile(settings, NUMBER_OF_SETTINGS, argv[++i]) != 0) {
+				return 1;
+			}
+		} else if (strcmp(argv[i], "-replay") == 0 && i + 1 < argc) {
+			if (loadRunLog(settings, NUMBER_OF_SETTINGS, argv[++i]) != 0) {
+				return 1;
+			}
+		} else if (argv[i][0] == '-' && i + 1 < argc && applySetting(settings, NUMBER_OF_SETTINGS, argv[i] + 1, argv[i + 1]) == 0) {
+			i++;
+		} else if (strcmp(argv[i], "-uring-depth") == 0 && i + 1 < argc && atoi(argv[i + 1]) > 0) {
+			setCopyQueueDepth(atoi(argv[++i]));
+		} else {
+			fprintf(stderr, "Usage: %s [-kernel scalar|sse|avx2|auto] [-copy stdio|ficlone|copy_file_range|sendfile|readwrite|uring]\n"
+					"       [-uring-depth N] [-source reread|cache|mmap] [-clock monotonic|tsc]\n"
+					"       [-warmup N] [-ci-width X] [-config FILE] [-replay FILE] [-iterations N] [-output-files N] [-equation-points N]\n"
+					"       [-counter-increments N] [-workers N] [-counter-grain N] [-equation-grain N] [-file-grain N]\n"
+					"       [-input FILE] [-output-root DIRECTORY] [-affinity none|compact|scatter|node|node:N|LIST]\n", argv[0]);
+			return 1;
+		}
+	}
+
+	return 0;
+}
@@ -18,153 +18,1053 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <pthread.h>
+#include <sched.h>
+#include <stdatomic.h>
 #include <math.h>
+#include <unistd.h>
 #include <sys/stat.h>
-#include <sys/time.h>
+#include "../common/equation.h"
+#include "../common/filecopy.h"
+#include "../common/timing.h"
+#include "../common/stats.h"
+#include "../common/config.h"
+#include "../common/affinity.h"
+#include "../common/histogram.h"
+#include "../common/perfcounters.h"
+#include "../common/coroutine.h"
+#include "../common/futex.h"
+#include "../common/locks.h"
+#include "../common/mpmcqueue.h"
 
-#define outFileName "outfiles%d/gpl.%d.txt"
-#define dirName "outfiles%d"
+#define OUT_FILE_FORMAT "outfiles%d/gpl.%d.txt"
+#define DIR_FORMAT "outfiles%d"
+#define PATH_SIZE 4096
+#define NUMBER_OF_SETTINGS (int)(sizeof(settings) / sizeof(Setting))
 #define SCREENING 1
+#define CACHE_LINE_SIZE 64
+// Keeps the compiler from folding a counting loop into a single add: every step loads and stores the counter
+#define COUNTER_STEP_BARRIER() __asm__ __volatile__("" ::: "memory")
+// Reads the payload of a coordinate handed to the consumer without any work on it: the empty asm takes the three values
+#define CONSUME_COORDINATE(point) __asm__ __volatile__("" :: "x"((point)->x), "x"((point)->y), "x"((point)->z))
 
-// Time tracker structure. Holds all time measurements relevant to this experiment.
+// Time tracker structure. Holds all time measurements relevant to this experiment, in nanoseconds.
 typedef struct {
-	double startTime, elapsedTime;
-	double iteractionStartTime, iteractionElapsedTime;
-	double counterStartTime, counterElapsedTime;
-	double equationStartTime, equationElapsedTime;
-	double fileStartTime, fileElapsedTime;
+	uint64_t startTime, elapsedTime;
+	uint64_t iteractionStartTime, iteractionElapsedTime;
+	uint64_t counterStartTime, counterElapsedTime;
+	uint64_t equationStartTime, equationElapsedTime;
+	uint64_t fileStartTime, fileElapsedTime;
+	uint64_t fileReadElapsedTime, fileWriteElapsedTime;
+	uint64_t threadStartTime, threadElapsedTime;
+	uint64_t threadCreateTime, threadTeardownTime; // Creating the threads, and joining them once their work is done
 } TimeTracker;
 
 // Structure containing the equation of 2 variables coordinates (x, y), its result (z) and the number of points to calculate
 typedef struct {
 	double x, y, z;
 	int qtdPointsToCalculate;
+	uint64_t publishTime; // When the producer handed the coordinate over, on "-latency"
 } EquationCoordinate;
 
+// Job handed to a pooled worker: the thread function it runs on every iteration, its argument, and the phase
+// counters its hardware events are added to on "-perf"
+typedef struct {
+	void *(*routine)(void *);
+	void *argument;
+	PerfCounts *perf;
+	uint64_t finishTime; // When the job last returned
+} PoolJob;
+
+/* Persistent worker pool. Workers are created once and wait for the generation number to change; each change
+ * dispatches one iteration of work. The last worker to finish signals the completion condition.
+ */
+typedef struct {
+	pthread_mutex_t mtx;
+	pthread_cond_t condDispatch, condComplete;
+	unsigned long generation;
+	int pending;
+	int shutdown;
+} WorkerPool;
+
+// How the equation producer hands each coordinate to the consumer
+typedef enum {
+	HANDOFF_CONDITION, // Single slot guarded by a mutex and a condition variable
+	HANDOFF_RING,      // Bounded single-producer/single-consumer lock-free ring
+	HANDOFF_COROUTINE, // Single slot shared by a generator and a consumer coroutine on the same executor
+	HANDOFF_FUTEX,     // Single slot on a futex: bounded spinning, then FUTEX_WAIT; FUTEX_WAKE only for a sleeper
+	HANDOFF_BATCH      // Double buffer of "-batch K" coordinates; one mutex and condition variable round trip per block
+} HandoffMode;
+
+/* Single-producer/single-consumer ring of coordinates. Head (consumer) and tail (producer) live on separate cache
+ * lines, and each side keeps a private copy of the other side's index so it only touches the shared line when the
+ * ring looks full or empty.
+ */
+typedef struct {
+	atomic_ulong head;
+	char padHead[CACHE_LINE_SIZE - sizeof(atomic_ulong)];
+	atomic_ulong tail;
+	char padTail[CACHE_LINE_SIZE - sizeof(atomic_ulong)];
+	unsigned long cachedHead; // Producer's view of head
+	char padCachedHead[CACHE_LINE_SIZE - sizeof(unsigned long)];
+	unsigned long cachedTail; // Consumer's view of tail
+	char padCachedTail[CACHE_LINE_SIZE - sizeof(unsigned long)];
+	unsigned long capacity, mask;
+	EquationCoordinate *slots;
+} CoordinateRing;
+
+/* Double buffer of coordinate blocks. The producer fills one block while the consumer drains the other, and they
+ * only synchronize when a block changes hands. A block is empty while its count is 0; counts are guarded by
+ * "mtxCondition", the positions are private to each side.
+ */
+typedef struct {
+	EquationCoordinate *blocks[2];
+	int counts[2];
+	int size;
+	int producerBlock, producerCount; // Block being filled and the coordinates already in it
+	int consumerBlock, consumerIndex; // Block being drained and the next coordinate to take from it
+} CoordinateBlocks;
+
+/* Coordinate cell behind a sequence lock. The writer makes the sequence odd, stores the coordinate and makes it even
+ * again; a reader copies the coordinate between two reads of the sequence and retries if they differ or are odd. The
+ * fields are atomics so that a torn copy is only discarded, never undefined.
+ */
+typedef struct {
+	atomic_uint sequence;
+	char padSequence[CACHE_LINE_SIZE - sizeof(atomic_uint)];
+	_Atomic double x, y, z;
+} SeqlockCoordinate;
+
+// Cell the snapshot readers copy the coordinate from
+typedef enum {
+	SNAPSHOT_MUTEX,  // "cord" under "mtxCondition", as getEquationResult() reads it
+	SNAPSHOT_SEQLOCK // "seqlockCord"; the writer never blocks and readers retry torn copies
+} SnapshotCell;
+
+// Snapshots taken by one reader, the copies it had to retry, and the snapshots whose x and y came from different points
+typedef struct {
+	unsigned long reads, retries, inconsistent;
+} SnapshotReader;
+
+// How the counter threads synchronize their updates
+typedef enum {
+	COUNTER_MUTEX,   // Every thread holds "counterLock" while it increments the shared counter
+	COUNTER_SHARDED, // Every thread increments its own shard; shards are added up after the threads complete
+	COUNTER_FETCH_ADD, // Every step is a single atomic fetch-and-add on the shared counter
+	COUNTER_CAS      // Every step is a compare-and-swap retry loop on the shared counter
+} CounterMode;
+
+// Work of a counter thread: how many increments to perform and which shard it owns. On "-lock", its handle on
+// "counterLock" and the time it spent waiting for it over the whole run
+typedef struct {
+	unsigned long increments;
+	int shard;
+	LockHandle lockHandle;
+	uint64_t waitTime;
+} CounterJob;
+
+// Per-thread counter, padded to a full cache line so that neighbouring shards do not share a line
+typedef struct {
+	unsigned long value;
+	char pad[CACHE_LINE_SIZE - sizeof(unsigned long)];
+} CounterShard;
+
+// Slice of the equation points evaluated by one thread on parallel equation mode, and the sum of its results
+typedef struct {
+	long firstPoint, count;
+	double sum;
+} EquationSlice;
+
+// Consumer on MPMC mode: the points it took from the queue on this iteration and the sum of their results, and the
+// points it took over the whole run
+typedef struct {
+	long points;
+	double sum;
+	unsigned long totalPoints;
+} EquationConsumer;
+
+// Stages of an iteration on "-pipeline". Setup comes first; the other three run at the same time
+typedef enum {
+	STAGE_SETUP,    // Creates the output directory of the iteration, which the file stage needs
+	STAGE_COUNTER,
+	STAGE_EQUATION,
+	STAGE_FILE,
+	PIPELINE_STAGES
+} PipelineStage;
+
+// Measurements of one iteration on "-pipeline", kept until the stages are done with the whole run
+typedef struct {
+	uint64_t startTime, finishTime, threadTime[PIPELINE_STAGES], teardownTime[PIPELINE_STAGES];
+	uint64_t counterTime, equationTime, fileTime, fileReadTime, fileWriteTime;
+	unsigned long counter, casFailures;
+} PipelineIteration;
+
+/* Iterations run as a pipeline. Every stage has a thread of its own that starts an iteration as soon as setup is done
+ * with it, so the counter, equation and file stages of an iteration overlap each other, as in a sequential iteration,
+ * and the stages of consecutive iterations overlap too. At most "depth" iterations are in flight: setup waits until
+ * every other stage is done with iteration N - depth.
+ */
+typedef struct {
+	pthread_mutex_t mtx;
+	pthread_cond_t condProgress;
+	int depth, numberOfIterations;
+	int completed[PIPELINE_STAGES]; // Iterations each stage is done with
+	int firstJob[PIPELINE_STAGES], numberOfJobs[PIPELINE_STAGES]; // Jobs of each stage in "jobs"
+	PoolJob *jobs;
+	PipelineIteration *iterations;
+	EquationSlice *equationSlices;
+	EquationConsumer *equationConsumers;
+	double expectedEquationSum;
+	unsigned long expectedCounter;
+} Pipeline;
+
+// Output files written by one file writer thread: "firstFile" to "firstFile + numberOfFiles - 1"
+typedef struct {
+	int firstFile, numberOfFiles;
+	int *directoryNumber;
+} FileSlice;
+
 EquationCoordinate cord;
 TimeTracker timeTracker;
+CoordinateRing ring;
+CoordinateBlocks coordinateBlocks;
+MpmcQueue equationQueue;
+SeqlockCoordinate seqlockCord;
+atomic_int snapshotWriterDone;
+atomic_long claimedPoints;
+CounterShard *counterShards;
+atomic_ulong atomicCounter;
+atomic_ulong casFailures;
+WorkerPool pool = {PTHREAD_MUTEX_INITIALIZER, PTHREAD_COND_INITIALIZER, PTHREAD_COND_INITIALIZER, 0, 0, 0};
+Pipeline pipeline = {
+	.mtx = PTHREAD_MUTEX_INITIALIZER,
+	.condProgress = PTHREAD_COND_INITIALIZER
+};
 
 // Global variables
-const int numberIteractions = 100;
-const int numberOfOutputFiles = 100;
-const int numberOfEquationPoints = 200000;
-const unsigned long numberOfCounterIncrements = 100000000;
-char *const inFileName = "gpl.txt";
+int numberIteractions = 100;
+int numberOfOutputFiles = 100;
+int numberOfEquationPoints = 200000;
+unsigned long numberOfCounterIncrements = 100000000;
+int numberOfCounterThreads = 100;
+char *inFileName = "gpl.txt";
+char *outputRoot = ".";
+char outFileName[PATH_SIZE], dirName[PATH_SIZE];
+
+// Workload settings, given as "-name value" on the command line or as "name = value" in a "-config" file
+const Setting settings[] = {
+	{"iterations", SETTING_INT, &numberIteractions},
+	{"output-files", SETTING_INT, &numberOfOutputFiles},
+	{"equation-points", SETTING_INT, &numberOfEquationPoints},
+	{"counter-increments", SETTING_ULONG, &numberOfCounterIncrements},
+	{"counter-threads", SETTING_INT, &numberOfCounterThreads},
+	{"input", SETTING_STRING, &inFileName},
+	{"output-root", SETTING_STRING, &outputRoot}
+};
 unsigned long counter;
 int dirNumber;
 int equationCalculated = 0;
 char *const FileName = "Posix.Stress.csv";
+char *const SummaryFileName = "Posix.Stress.Summary.csv";
+char *const ScalingFileName = "Posix.Stress.EquationScaling.csv";
+char *const FileScalingFileName = "Posix.Stress.FileScaling.csv";
+char *const BatchScalingFileName = "Posix.Stress.BatchScaling.csv";
+char *const MpmcGridFileName = "Posix.Stress.MpmcGrid.csv";
+char *const SnapshotFileName = "Posix.Stress.Snapshot.csv";
+const char *const SnapshotCellNames[] = {"mutex", "seqlock"};
+int usePool = 0;
+int numberOfExecutors = 0;
+HandoffMode handoffMode = HANDOFF_CONDITION;
+const char *const HandoffNames[] = {"condition", "ring", "coroutine", "futex", "batch"};
+FutexHandoff equationHandoff;
+unsigned futexSpinLimit = 100;
+unsigned long ringCapacity = 1024;
+int batchSize = 64;
+int batchScalingSize = 0;
+CounterMode counterMode = COUNTER_MUTEX;
+memory_order counterOrder = memory_order_seq_cst;
+LockKind counterLockKind = LOCK_MUTEX;
+CounterLock counterLock;
+int measureLock = 0;
+LatencyHistogram lockLatency;
+EquationKernel equationKernel = KERNEL_SCALAR;
+EquationBatchFunction evaluateEquation;
+CopyBackend copyBackend = COPY_STDIO;
+ClockSource clockSource = CLOCK_SOURCE_MONOTONIC;
+char *placement = "none";
+int warmupIterations = 5;
+double confidenceWidth = 0;
+const char *const SummaryColumns[] = {"Counter Time", "Equation Time", "File Time", "Iteration Time"};
+SourceMode sourceMode = SOURCE_REREAD;
+SourceFile sourceFile;
+int measureLatency = 0;
+LatencyHistogram handoffLatency;
+int measurePerf = 0;
+PerfCounts counterPerf, equationPerf, filePerf;
+int numberOfEquationThreads = 0;
+int numberOfProducers = 0;
+int numberOfConsumers = 0;
+QueueKind queueKind = QUEUE_LOCK;
+long queuedPoints;
+int mpmcGridSize = 0;
+SnapshotCell snapshotCell;
+int snapshotReaders = 0;
+int pipelineDepth = 0;
+long equationScalingPoints = 0;
+int numberOfFileWriters = 1;
+int fileScalingWriters = 0;
 
 // Posix mutexes and semaphores
 pthread_mutex_t mtxCounter;
 pthread_mutex_t mtxCondition = PTHREAD_MUTEX_INITIALIZER;
 pthread_cond_t condEquation = PTHREAD_COND_INITIALIZER;
+pthread_mutex_t mtxEquationTime = PTHREAD_MUTEX_INITIALIZER;
+pthread_mutex_t mtxFileTime = PTHREAD_MUTEX_INITIALIZER;
 
 // Prototypes of functions executed by threads
-void *incrementCounter(void *numIncs);
-void *replicateFile(void *directoryNumber);
+void *incrementCounter(void *counterJob);
+void *replicateFile(void *fileSlice);
 void *consumeEquationResults();
 void *produceEquationResults();
+void *poolWorker(void *job);
+void *runJob(void *job);
+void *evaluateEquationSlice(void *equationSlice);
+void *produceEquationQueue(void *equationSlice);
+void *consumeEquationQueue(void *equationConsumer);
+void *writeSnapshots();
+void *readSnapshots(void *snapshotReader);
+void *runPipelineStage(void *pipelineStage);
+int getPipelineCompleted();
 
 // Prototypes of functions using or used by the threads
-double getTimeMilliseconds();
-void getEquationResult();
+void getEquationResult(LatencyHistogram *latency);
 void calculateEquation(int i);
+void getEquationResultRing(LatencyHistogram *latency);
+void calculateEquationRing(int i);
+void publishEquationResult(EquationCoordinate *point);
+void publishEquationResultRing(EquationCoordinate *point);
+void getEquationResultCoroutine(LatencyHistogram *latency);
+void calculateEquationCoroutine(int i);
+void publishEquationResultCoroutine(EquationCoordinate *point);
+void getEquationResultFutex(LatencyHistogram *latency);
+void calculateEquationFutex(int i);
+void publishEquationResultFutex(EquationCoordinate *point);
+void getEquationResultBatch(LatencyHistogram *latency);
+void calculateEquationBatch(int i);
+void publishEquationResultBatch(EquationCoordinate *point);
+void flushEquationBatch();
+void produceEquationBatches();
+void splitEquationPoints(EquationSlice *slices, int numberOfSlices, long numberOfPoints);
+double sumEquationSlices(EquationSlice *slices, int numberOfSlices);
+void runEquationScaling(long numberOfPoints);
+void runBatchScaling(int maximumSize);
+void runMpmcGrid(int maximumThreads);
+void runSnapshotReaders(int maximumReaders);
+void resetCounterPhase();
+void resetEquationPhase();
+void checkCounter(int iteraction, unsigned long expectedCounter);
+void checkEquationSum(int iteraction, EquationSlice *slices, EquationConsumer *consumers, double expectedSum);
+void runPipeline(PoolJob *jobs, int equationThreads, EquationSlice *slices, EquationConsumer *consumers, double expectedEquationSum,
+		unsigned long expectedCounter);
+void loadPipelineIteration(int iteraction);
+double getConsumerBalance(EquationConsumer *consumers, int numberOfConsumers, double *minimum, double *maximum);
+void splitOutputFiles(FileSlice *slices, int numberOfSlices, int *directoryNumber);
+void runFileScaling(int maximumWriters, size_t fileSize);
+void incrementCounterSharded(CounterJob *job);
+void incrementCounterAtomic(CounterJob *job);
+void markCounterStart();
+void markCounterFinish();
+unsigned long reduceCounterShards();
+void printLockSummary(CounterJob *jobs, int numberOfJobs, uint64_t counterTime);
+void initRing(unsigned long capacity);
+void resetRing();
+void initBatch(int size);
+void resetBatch();
+void dispatchPool(int numberOfJobs);
+uint64_t shutdownPool(pthread_t *threads, int numberOfThreads);
+uint64_t getTeardownTime(PoolJob *jobs, int numberOfJobs);
+void waitPool();
+int parseArguments(int argc, char *argv[]);
 
 /* Executes the experiment 'numberIteractions' times. On each cycle integer, floating point, and I/O operations
  * are performed.
  */
 int main(int argc, char *argv[]) {
-	// Starts counting time
-	timeTracker.startTime = getTimeMilliseconds();
-	
 	// Declaration of variables
-	int numberOfThreads = 103; // 100 - counter; 2 - equation; 1 - file
+	if (parseArguments(argc, argv) != 0) {
+		return 1;
+	}
+	clockSource = initTiming(clockSource);
+	if (initPlacement(placement) != 0) {
+		fprintf(stderr, "Placement %s is not valid on this machine\n", placement);
+		return 1;
+	}
+	
+	// Output directories and files are created under "outputRoot"
+	buildOutputFormat(outFileName, sizeof(outFileName), outputRoot, OUT_FILE_FORMAT);
+	buildOutputFormat(dirName, sizeof(dirName), outputRoot, DIR_FORMAT);
+	mkdir(outputRoot, S_IRWXU | S_IRGRP | S_IXGRP | S_IROTH | S_IXOTH);
+	resetHistogram(&handoffLatency);
+	if (measurePerf) {
+		measurePerf = initPerfCounters() > 0;
+	}
+	
+	// Starts counting time, once the clock is calibrated
+	timeTracker.startTime = getTimeNanoseconds();
+	
+	// 100 - counter; 2 - equation (producer and consumer), "numberOfEquationThreads" on parallel mode, or producers
+	// plus consumers on MPMC mode; "numberOfFileWriters" - file
+	int equationThreads = numberOfEquationThreads > 0 ? numberOfEquationThreads : numberOfProducers > 0 ? numberOfProducers + numberOfConsumers : 2;
+	int numberOfThreads = numberOfCounterThreads + equationThreads + numberOfFileWriters;
 	pthread_t threads[numberOfThreads];
 	pthread_attr_t attr;
 	unsigned long incrementsPerThread;
+	CounterJob counterJobs[numberOfCounterThreads];
+	EquationSlice equationSlices[equationThreads];
+	EquationConsumer equationConsumers[numberOfConsumers > 0 ? numberOfConsumers : 1];
+	FileSlice fileSlices[numberOfFileWriters];
+	double expectedEquationSum = 0;
+	struct stat inFileStatus;
 	char *dName;
 	FILE *fp;
-	double currentTime;
-			
-	incrementsPerThread = numberOfCounterIncrements / 100;
+	uint64_t currentTime;
+	double counterThroughput, casFailureRate, fileThroughput;
+	PoolJob jobs[numberOfThreads];
+
+	incrementsPerThread = numberOfCounterIncrements / numberOfCounterThreads;
 	cord.qtdPointsToCalculate = numberOfEquationPoints;
+	equationKernel = selectEquationKernel(equationKernel, numberOfEquationPoints);
+	evaluateEquation = getEquationBatchFunction(equationKernel);
+	if (copyBackend != COPY_STDIO) {
+		printf("File backend: %s\n", getCopyBackendName(copyBackend));
+	}
+	
+	// The input file can be loaded once and shared by every iteration instead of being read again for every output
+	if (sourceMode != SOURCE_REREAD) {
+		currentTime = getTimeNanoseconds();
+		if (loadSourceFile(inFileName, sourceMode, &sourceFile) != 0) {
+			fprintf(stderr, "Could not load %s, reading it on every iteration\n", inFileName);
+		}
+		printf("Source file loaded once in %.3f\n", toMilliseconds(getTimeNanoseconds() - currentTime));
+	}
+	
+	if (equationScalingPoints > 0) {
+		runEquationScaling(equationScalingPoints);
+	}
+	if (batchScalingSize > 0) {
+		runBatchScaling(batchScalingSize);
+	}
+	if (mpmcGridSize > 0) {
+		runMpmcGrid(mpmcGridSize);
+	}
+	if (snapshotReaders > 0) {
+		runSnapshotReaders(snapshotReaders);
+	}
+	
+	stat(inFileName, &inFileStatus);
+	if (fileScalingWriters > 0) {
+		runFileScaling(fileScalingWriters, inFileStatus.st_size);
+	}
+	
+	// Parallel equation and MPMC modes check every iteration against the sum of the results of the sequential producer,
+	// within the drift that its walk accumulates on large ranges (see getEquationSequenceTolerance())
+	if (numberOfEquationThreads > 0) {
+		expectedEquationSum = evaluateEquationSequence(evaluateEquation, numberOfEquationPoints);
+		splitEquationPoints(equationSlices, numberOfEquationThreads, numberOfEquationPoints);
+	} else if (numberOfProducers > 0) {
+		expectedEquationSum = evaluateEquationSequence(evaluateEquation, numberOfEquationPoints);
+		splitEquationPoints(equationSlices, numberOfProducers, numberOfEquationPoints);
+		initMpmcQueue(&equationQueue, queueKind, ringCapacity);
+		queuedPoints = numberOfEquationPoints;
+	}
+	
+	if (counterMode == COUNTER_SHARDED &&
+			posix_memalign((void **)&counterShards, CACHE_LINE_SIZE, numberOfCounterThreads * sizeof(CounterShard)) != 0) {
+		fprintf(stderr, "Could not allocate %d counter shards\n", numberOfCounterThreads);
+		return 1;
+	}
 	
 	// Creates file to host the experiment's log	
 	fp = fopen(FileName, "w");
-	fprintf(fp, "Elapsed Time, Iteration Time, Counter Time, Equation Time, File Time\n");
+	writeSettings(fp, settings, NUMBER_OF_SETTINGS);
+	writeCommandLine(fp, argc, argv);
+	fprintf(fp, "# kernel = %s\n", getEquationKernelName(equationKernel));
+	writePlacement(fp, numberOfThreads);
+	#if SCREENING == 1 
+		writePlacement(stdout, numberOfThreads);
+	#endif
+	fprintf(fp, "Elapsed Time, Iteration Time, Counter Time, Equation Time, File Time, Thread Time, Counter Throughput, CAS Failure Rate, File Throughput, File Read Time, File Write Time, Thread Create Time, Thread Teardown Time");
+	if (measurePerf) {
+		writePerfHeader(fp, "Counter");
+		writePerfHeader(fp, "Equation");
+		writePerfHeader(fp, "File");
+	}
+	fprintf(fp, "\n");
 
 	// Initializes mutexes (some are already initialized), and thread attributes
 	pthread_mutex_init(&mtxCounter, NULL);
+	initCounterLock(&counterLock, counterLockKind);
+	resetHistogram(&lockLatency);
 	pthread_attr_init(&attr); 
 	pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_JOINABLE);	
 	
+	if (handoffMode == HANDOFF_RING) {
+		initRing(ringCapacity);
+	} else if (handoffMode == HANDOFF_FUTEX) {
+		initFutexHandoff(&equationHandoff, futexSpinLimit);
+	} else if (handoffMode == HANDOFF_BATCH) {
+		initBatch(batchSize);
+	}
+	
+	// Assigns each thread its job. The same layout is used to spawn threads or to feed the pool
+	int iteraction, i, j, confidenceReached = 0;
+	unsigned long handoffs = 0;
+	uint64_t handoffElapsedTime = 0, lockElapsedTime = 0;
+	SampleTable samples;
+	double sampleRow[4];
+	if (numberOfEquationThreads > 0) {
+		for (i = 0; i < numberOfEquationThreads; i++) {
+			jobs[i].routine = evaluateEquationSlice;
+			jobs[i].argument = (void *)&equationSlices[i];
+			jobs[i].perf = &equationPerf;
+		}
+	} else if (numberOfProducers > 0) {
+		for (i = 0; i < numberOfProducers; i++) {
+			jobs[i].routine = produceEquationQueue;
+			jobs[i].argument = (void *)&equationSlices[i];
+			jobs[i].perf = &equationPerf;
+		}
+		for (i = 0; i < numberOfConsumers; i++) {
+			equationConsumers[i].totalPoints = 0;
+			jobs[numberOfProducers + i].routine = consumeEquationQueue;
+			jobs[numberOfProducers + i].argument = (void *)&equationConsumers[i];
+			jobs[numberOfProducers + i].perf = &equationPerf;
+		}
+	} else {
+		jobs[0].routine = consumeEquationResults;
+		jobs[0].argument = NULL;
+		jobs[1].routine = produceEquationResults;
+		jobs[1].argument = NULL;
+		jobs[0].perf = &equationPerf;
+		jobs[1].perf = &equationPerf;
+	}
+	splitOutputFiles(fileSlices, numberOfFileWriters, &dirNumber);
+	for (i = 0; i < numberOfFileWriters; i++) {
+		jobs[equationThreads + i].routine = replicateFile;
+		jobs[equationThreads + i].argument = (void *)&fileSlices[i];
+		jobs[equationThreads + i].perf = &filePerf;
+	}
+	
+	for (i = 0; i < numberOfCounterThreads; i++) {
+		counterJobs[i].increments = incrementsPerThread;
+		counterJobs[i].shard = i;
+		counterJobs[i].waitTime = 0;
+		initLockHandle(&counterJobs[i].lockHandle);
+		jobs[equationThreads + numberOfFileWriters + i].routine = incrementCounter;
+		jobs[equationThreads + numberOfFileWriters + i].argument = (void *)&counterJobs[i];
+		jobs[equationThreads + numberOfFileWriters + i].perf = &counterPerf;
+	}
+	
+	// On coroutine mode every job is a coroutine; the producer and the consumer share the first executor, the other
+	// jobs are dealt round robin. Stacks are allocated once and reused by every iteration
+	CoroutineExecutor executors[numberOfExecutors > 0 ? numberOfExecutors : 1];
+	pthread_t executorThreads[numberOfExecutors > 0 ? numberOfExecutors : 1];
+	Coroutine *coroutines = NULL;
+	int jobExecutor[numberOfThreads];
+	if (numberOfExecutors > 0) {
+		coroutines = (Coroutine *)malloc(numberOfThreads * sizeof(Coroutine));
+		for (i = 0; i < numberOfThreads; i++) {
+			initCoroutine(&coroutines[i], COROUTINE_STACK_SIZE);
+			jobExecutor[i] = numberOfEquationThreads == 0 && i < 2 ? 0 : i % numberOfExecutors;
+		}
+		for (i = 0; i < numberOfExecutors; i++) {
+			initExecutor(&executors[i]);
+		}
+	}
+	
+	// On pool mode the threads are created only once; the creation cost is accounted to the first iteration, as the
+	// teardown cost is to the last one
+	uint64_t poolStartupTime = 0, poolTeardownTime = 0, createStartTime;
+	if (usePool) {
+		timeTracker.threadStartTime = getTimeNanoseconds();
+		for (i = 0; i < numberOfThreads; i++) {
+			setThreadPlacement(&attr, i);
+			pthread_create(&threads[i], &attr, poolWorker, (void *)&jobs[i]);
+		}
+		poolStartupTime = getTimeNanoseconds() - timeTracker.threadStartTime;
+	}
+	
 	// Loops "numberIteractions" times to generate enough statistical data for analysis
-	int iteraction, i, j;
+	initSampleTable(&samples, SummaryColumns, 4, numberIteractions);
+	if (pipelineDepth > 0) {
+		runPipeline(jobs, equationThreads, equationSlices, equationConsumers, expectedEquationSum,
+				incrementsPerThread * numberOfCounterThreads);
+	}
 	for (iteraction = 0; iteraction < numberIteractions; iteraction++) {
-		timeTracker.iteractionStartTime = getTimeMilliseconds();
-		counter = 0;
-		timeTracker.counterStartTime = 0;
-		
-		cord.x = 0;
-		cord.y = cord.x;
+		if (pipelineDepth > 0) {
+			// The stages already ran this iteration; only its measurements are left to report
+			loadPipelineIteration(iteraction);
+		} else {
+			timeTracker.iteractionStartTime = getTimeNanoseconds();
+			resetCounterPhase();
+			resetEquationPhase();
+			timeTracker.fileStartTime = 0;
+			timeTracker.fileReadElapsedTime = 0;
+			timeTracker.fileWriteElapsedTime = 0;
+			resetPerfCounts(&counterPerf);
+			resetPerfCounts(&equationPerf);
+			resetPerfCounts(&filePerf);
 
-		dName = malloc(sizeof(dirName) + 4);
-		sprintf((char *)dName, dirName, iteraction);
-		mkdir((char *)dName, S_IRWXU | S_IRGRP | S_IROTH);
-		free(dName);
-		dName = NULL;
-		dirNumber = iteraction;
+			dName = malloc(sizeof(dirName) + 4);
+			sprintf((char *)dName, dirName, iteraction);
+			mkdir((char *)dName, S_IRWXU | S_IRGRP | S_IROTH);
+			free(dName);
+			dName = NULL;
+			dirNumber = iteraction;
 		
-        // Creates all the threads
-		pthread_create(&threads[0], &attr, consumeEquationResults, NULL);
-		pthread_create(&threads[1], &attr, produceEquationResults, NULL);
-		pthread_create(&threads[2], &attr, replicateFile, (void *)&dirNumber);
+			timeTracker.threadCreateTime = 0;
+			timeTracker.threadTeardownTime = 0;
+			timeTracker.threadStartTime = getTimeNanoseconds();
+			if (usePool) {
+                // Hands the work of this iteration to the pooled threads and waits for all of them to complete
+				dispatchPool(numberOfThreads);
+				timeTracker.threadElapsedTime = getTimeNanoseconds() - timeTracker.threadStartTime;
+				if (iteraction == 0) {
+					timeTracker.threadElapsedTime += poolStartupTime;
+					timeTracker.threadCreateTime = poolStartupTime;
+				}
+				waitPool();
+			} else if (numberOfExecutors > 0) {
+                // Queues every job as a coroutine and runs each executor on a thread of its own
+				for (i = 0; i < numberOfThreads; i++) {
+					spawnCoroutine(&executors[jobExecutor[i]], &coroutines[i], runJob, (void *)&jobs[i]);
+				}
+				createStartTime = getTimeNanoseconds();
+				for (i = 0; i < numberOfExecutors; i++) {
+					setThreadPlacement(&attr, i);
+					pthread_create(&executorThreads[i], &attr, runExecutor, (void *)&executors[i]);
+				}
+				timeTracker.threadElapsedTime = getTimeNanoseconds() - timeTracker.threadStartTime;
+				timeTracker.threadCreateTime = getTimeNanoseconds() - createStartTime;
+			
+				for (j = 0; j < numberOfExecutors; j++) {
+					pthread_join(executorThreads[j], NULL);
+				}
+				timeTracker.threadTeardownTime = getTeardownTime(jobs, numberOfThreads);
+			} else {
+                // Creates all the threads
+				for (i = 0; i < numberOfThreads; i++) {
+					setThreadPlacement(&attr, i);
+					pthread_create(&threads[i], &attr, runJob, (void *)&jobs[i]);
+				}
+				timeTracker.threadElapsedTime = getTimeNanoseconds() - timeTracker.threadStartTime;
+				timeTracker.threadCreateTime = timeTracker.threadElapsedTime;
+			
+                // Waits for all threads to complete
+				for (j = 0; j < numberOfThreads; j++) {
+					pthread_join(threads[j], NULL);
+				}
+				timeTracker.threadTeardownTime = getTeardownTime(jobs, numberOfThreads);
+			}
 		
-		for (i = 3; i < numberOfThreads; i++) {
-			pthread_create(&threads[i], &attr, incrementCounter, (void *)&incrementsPerThread);
+			checkCounter(iteraction, incrementsPerThread * numberOfCounterThreads);
+			checkEquationSum(iteraction, equationSlices, equationConsumers, expectedEquationSum);
 		}
 		
-        // Waits for all threads to complete
-		for (j = 0; j < numberOfThreads; j++) {
-			pthread_join(threads[j], NULL);
-		}
+        // Increments per second, the share of compare-and-swap attempts that had to be retried, and MB/s written
+		counterThroughput = timeTracker.counterElapsedTime > 0 ? counter * (double)NANOSECONDS_PER_SECOND / timeTracker.counterElapsedTime : 0;
+		casFailureRate = (double)atomic_load(&casFailures) / (atomic_load(&casFailures) + incrementsPerThread * numberOfCounterThreads);
+		fileThroughput = timeTracker.fileElapsedTime > 0 ?
+				(double)inFileStatus.st_size * numberOfOutputFiles / (1024 * 1024) / (timeTracker.fileElapsedTime / (double)NANOSECONDS_PER_SECOND) : 0;
 		
         // Saves result of the current iteration on the log file
-		currentTime = getTimeMilliseconds();
+		currentTime = pipelineDepth > 0 ? pipeline.iterations[iteraction].finishTime : getTimeNanoseconds();
 		timeTracker.iteractionElapsedTime = currentTime - timeTracker.iteractionStartTime;
 		timeTracker.elapsedTime = currentTime - timeTracker.startTime;
-		fprintf(fp, "%.3f, %.3f, %.3f, %.3f, %.3f\n", timeTracker.elapsedTime, timeTracker.iteractionElapsedTime, timeTracker.counterElapsedTime,
-				timeTracker.equationElapsedTime, timeTracker.fileElapsedTime);
+		
+		// Stops once every phase is measured precisely enough, without waiting for the remaining iterations
+		sampleRow[0] = toMilliseconds(timeTracker.counterElapsedTime);
+		sampleRow[1] = toMilliseconds(timeTracker.equationElapsedTime);
+		sampleRow[2] = toMilliseconds(timeTracker.fileElapsedTime);
+		sampleRow[3] = toMilliseconds(timeTracker.iteractionElapsedTime);
+		addSampleRow(&samples, sampleRow);
+		confidenceReached = confidenceWidth > 0 && isConfidenceReached(&samples, warmupIterations, confidenceWidth);
+		
+		// The pooled threads are joined on the last iteration, so their teardown is reported like the one of spawned threads
+		if (usePool && (confidenceReached || iteraction == numberIteractions - 1)) {
+			poolTeardownTime = shutdownPool(threads, numberOfThreads);
+			timeTracker.threadTeardownTime = poolTeardownTime;
+		}
+		
+		fprintf(fp, "%.3f, %.3f, %.3f, %.3f, %.3f, %.3f, %.0f, %.6f, %.3f, %.3f, %.3f, %.3f, %.3f", toMilliseconds(timeTracker.elapsedTime),
+				toMilliseconds(timeTracker.iteractionElapsedTime), toMilliseconds(timeTracker.counterElapsedTime),
+				toMilliseconds(timeTracker.equationElapsedTime), toMilliseconds(timeTracker.fileElapsedTime),
+				toMilliseconds(timeTracker.threadElapsedTime), counterThroughput, casFailureRate, fileThroughput,
+				toMilliseconds(timeTracker.fileReadElapsedTime), toMilliseconds(timeTracker.fileWriteElapsedTime),
+				toMilliseconds(timeTracker.threadCreateTime), toMilliseconds(timeTracker.threadTeardownTime));
+		if (measurePerf) {
+			writePerfValues(fp, &counterPerf);
+			writePerfValues(fp, &equationPerf);
+			writePerfValues(fp, &filePerf);
+		}
+		fprintf(fp, "\n");
 		
         // If running on screening mode, also show the results on the screen
 		#if SCREENING == 1 
-			printf("%d -> %.3f, %.3f, %.3f, %.3f, %.3f\n", iteraction, timeTracker.elapsedTime, timeTracker.iteractionElapsedTime,
-                   timeTracker.counterElapsedTime, timeTracker.equationElapsedTime, timeTracker.fileElapsedTime);
+			printf("%d -> %.3f, %.3f, %.3f, %.3f, %.3f, %.3f, %.0f, %.6f, %.3f, %.3f, %.3f, %.3f, %.3f\n", iteraction, toMilliseconds(timeTracker.elapsedTime),
+                   toMilliseconds(timeTracker.iteractionElapsedTime), toMilliseconds(timeTracker.counterElapsedTime),
+                   toMilliseconds(timeTracker.equationElapsedTime), toMilliseconds(timeTracker.fileElapsedTime),
+                   toMilliseconds(timeTracker.threadElapsedTime), counterThroughput, casFailureRate, fileThroughput,
+                   toMilliseconds(timeTracker.fileReadElapsedTime), toMilliseconds(timeTracker.fileWriteElapsedTime),
+                   toMilliseconds(timeTracker.threadCreateTime), toMilliseconds(timeTracker.threadTeardownTime));
 		#endif
+		
+		handoffs += numberOfEquationPoints;
+		handoffElapsedTime += timeTracker.equationElapsedTime;
+		lockElapsedTime += timeTracker.counterElapsedTime;
+		
+		if (confidenceReached) {
+			printf("Confidence interval within %.3f of the mean after %d iterations, stopping\n", confidenceWidth, iteraction + 1);
+			break;
+		}
 	}
 	
 	fclose(fp); // Closes experiment's log file
+	writeSampleSummary(&samples, warmupIterations, SummaryFileName);
+	freeSampleTable(&samples);
+	releaseSourceFile(&sourceFile);
+	free(pipeline.iterations);
+	
+	// Tail latency of the producer to consumer handoff over the whole run. Every sample includes one clock read
+	if (measureLatency) {
+		printHistogramSummary("Handoff latency", &handoffLatency);
+		printf("Clock read overhead included in each sample: %llu ns\n", (unsigned long long)getTimingOverhead());
+	}
+	
+	// Coordinates handed from the producer to the consumer per second of Equation Time, to compare the handoff modes
+	if (numberOfEquationThreads == 0 && numberOfProducers == 0 && handoffElapsedTime > 0) {
+		printf("Handoff throughput (%s): %.0f handoffs/sec\n", HandoffNames[handoffMode],
+				handoffs * (double)NANOSECONDS_PER_SECOND / handoffElapsedTime);
+		if (handoffMode == HANDOFF_FUTEX) {
+			printFutexHandoffSummary(&equationHandoff, handoffs);
+		}
+	}
+	
+	// Points going through the shared queue per second of Equation Time, and how evenly the consumers took them
+	if (numberOfProducers > 0) {
+		double minimumShare, maximumShare, fairness;
+		fairness = getConsumerBalance(equationConsumers, numberOfConsumers, &minimumShare, &maximumShare);
+		printf("Queue %s: %d producers, %d consumers, %.0f points/sec\n", getQueueKindName(queueKind), numberOfProducers,
+				numberOfConsumers, handoffElapsedTime > 0 ? handoffs * (double)NANOSECONDS_PER_SECOND / handoffElapsedTime : 0);
+		printf("Queue %s: points per consumer min %.3f, max %.3f of an even share, Jain fairness %.4f\n", getQueueKindName(queueKind),
+				minimumShare, maximumShare, fairness);
+		destroyMpmcQueue(&equationQueue);
+	}
+	
+	if (measureLock) {
+		printLockSummary(counterJobs, numberOfCounterThreads, lockElapsedTime);
+	}
+	for (i = 0; i < numberOfCounterThreads; i++) {
+		releaseLockHandle(&counterJobs[i].lockHandle);
+	}
+
+	// Switches into coroutines, and the stack memory they use compared to what as many threads would reserve
+	if (numberOfExecutors > 0) {
+		size_t threadStackSize;
+		unsigned long switches = 0;
+		pthread_attr_getstacksize(&attr, &threadStackSize);
+		for (i = 0; i < numberOfExecutors; i++) {
+			switches += executors[i].switches;
+		}
+		for (i = 0; i < numberOfThreads; i++) {
+			releaseCoroutine(&coroutines[i]);
+		}
+		free(coroutines);
+		
+		printf("Coroutines: %d on %d executor threads, %lu switches, %zu KB of stacks (%d threads reserve %zu KB)\n",
+				numberOfThreads, numberOfExecutors, switches, numberOfThreads * (size_t)COROUTINE_STACK_SIZE / 1024,
+				numberOfThreads, numberOfThreads * threadStackSize / 1024);
+	}
+	
+    // Releases what is left of the pool; its threads were joined on the last iteration
+	if (usePool) {
+		#if SCREENING == 1 
+			printf("Pool startup: %.3f, Pool teardown: %.3f\n", toMilliseconds(poolStartupTime), toMilliseconds(poolTeardownTime));
+		#endif
+		
+		pthread_cond_destroy(&pool.condDispatch);
+		pthread_cond_destroy(&pool.condComplete);
+		pthread_mutex_destroy(&pool.mtx);
+	}
 
     // Frees mutexes and thread attributes
     pthread_mutex_destroy(&mtxCounter);
+    destroyCounterLock(&counterLock);
     pthread_cond_destroy(&condEquation);
     pthread_mutex_destroy(&mtxCondition);
 	pthread_attr_destroy(&attr);
+	free(ring.slots);
+	free(coordinateBlocks.blocks[0]);
+	free(counterShards);
 	pthread_exit(NULL);
 }
 
-// Increments a counter "numIncs" times. Only one thread can execute it at any given time.
-void *incrementCounter(void *numIncs) {
-	pthread_mutex_lock(&mtxCounter);
+// Clears the counter of the previous iteration. Only called while no counter thread is running
+void resetCounterPhase() {
+	counter = 0;
+	timeTracker.counterStartTime = 0;
+	if (counterMode == COUNTER_SHARDED) {
+		memset(counterShards, 0, numberOfCounterThreads * sizeof(CounterShard));
+	}
+	atomic_store(&atomicCounter, 0);
+	atomic_store(&casFailures, 0);
+}
+
+// Rewinds the equation and empties the handoff. Only called while no equation thread is running
+void resetEquationPhase() {
+	timeTracker.equationStartTime = 0;
+	cord.x = 0;
+	cord.y = cord.x;
+	if (handoffMode == HANDOFF_RING) {
+		resetRing();
+	} else if (handoffMode == HANDOFF_BATCH) {
+		resetBatch();
+	}
+	if (numberOfProducers > 0) {
+		resetMpmcQueue(&equationQueue);
+		atomic_store(&claimedPoints, 0);
+	}
+}
+
+// Leaves the final count in "counter" once the counter threads complete, and reports a lost update
+void checkCounter(int iteraction, unsigned long expectedCounter) {
+	if (counterMode == COUNTER_SHARDED) {
+		counter = reduceCounterShards();
+	} else if (counterMode == COUNTER_FETCH_ADD || counterMode == COUNTER_CAS) {
+		counter = atomic_load(&atomicCounter);
+	}
+	if (counter != expectedCounter) {
+		fprintf(stderr, "Iteration %d: counter is %lu, expected %lu\n", iteraction, counter, expectedCounter);
+	}
+}
+
+/* On parallel equation and MPMC modes, compares the sum of the results of the iteration with the sequential one once
+ * the equation threads complete. On MPMC mode also adds the points of each consumer to its total.
+ */
+void checkEquationSum(int iteraction, EquationSlice *slices, EquationConsumer *consumers, double expectedSum) {
+	double equationSum = 0;
+	int i;
+	
+	if (numberOfEquationThreads > 0) {
+		equationSum = sumEquationSlices(slices, numberOfEquationThreads);
+	} else if (numberOfProducers > 0) {
+		for (i = 0; i < numberOfConsumers; i++) {
+			equationSum += consumers[i].sum;
+			consumers[i].totalPoints += consumers[i].points;
+		}
+	} else {
+		return;
+	}
+	
+	if (fabs(equationSum - expectedSum) > getEquationSequenceTolerance(numberOfEquationPoints) * fabs(expectedSum)) {
+		fprintf(stderr, "Iteration %d: equation sum is %.9f, expected %.9f\n", iteraction, equationSum, expectedSum);
+	}
+}
+
+/* Runs all the iterations as a pipeline of "pipelineDepth" iterations, one thread per stage, and keeps the measurements
+ * of every iteration for main() to report. Prints the sustained iterations per second next to the mean latency of an
+ * iteration, from the start of its setup to the end of its last stage.
+ */
+void runPipeline(PoolJob *jobs, int equationThreads, EquationSlice *slices, EquationConsumer *consumers, double expectedEquationSum,
+		unsigned long expectedCounter) {
+	PipelineStage stages[PIPELINE_STAGES];
+	pthread_t threads[PIPELINE_STAGES];
+	uint64_t latency = 0;
+	int i;
+	
+	pipeline.depth = pipelineDepth;
+	pipeline.numberOfIterations = numberIteractions;
+	pipeline.jobs = jobs;
+	pipeline.firstJob[STAGE_SETUP] = 0;
+	pipeline.numberOfJobs[STAGE_SETUP] = 0;
+	pipeline.firstJob[STAGE_EQUATION] = 0;
+	pipeline.numberOfJobs[STAGE_EQUATION] = equationThreads;
+	pipeline.firstJob[STAGE_FILE] = equationThreads;
+	pipeline.numberOfJobs[STAGE_FILE] = numberOfFileWriters;
+	pipeline.firstJob[STAGE_COUNTER] = equationThreads + numberOfFileWriters;
+	pipeline.numberOfJobs[STAGE_COUNTER] = numberOfCounterThreads;
+	pipeline.equationSlices = slices;
+	pipeline.equationConsumers = consumers;
+	pipeline.expectedEquationSum = expectedEquationSum;
+	pipeline.expectedCounter = expectedCounter;
+	pipeline.iterations = (PipelineIteration *)calloc(numberIteractions, sizeof(PipelineIteration));
+	
+	for (i = 0; i < PIPELINE_STAGES; i++) {
+		pipeline.completed[i] = 0;
+		stages[i] = (PipelineStage)i;
+		pthread_create(&threads[i], NULL, runPipelineStage, (void *)&stages[i]);
+	}
+	for (i = 0; i < PIPELINE_STAGES; i++) {
+		pthread_join(threads[i], NULL);
+	}
+	
+	for (i = 0; i < numberIteractions; i++) {
+		latency += pipeline.iterations[i].finishTime - pipeline.iterations[i].startTime;
+	}
+	printf("Pipeline depth %d: %d iterations in %.3f, %.3f iterations/sec, iteration latency mean %.3f\n", pipelineDepth,
+			numberIteractions, toMilliseconds(pipeline.iterations[numberIteractions - 1].finishTime - pipeline.iterations[0].startTime),
+			numberIteractions * (double)NANOSECONDS_PER_SECOND / (pipeline.iterations[numberIteractions - 1].finishTime - pipeline.iterations[0].startTime),
+			toMilliseconds(latency / numberIteractions));
+}
+
+// Iterations that the counter, equation and file stages are all done with. Only called holding "pipeline.mtx"
+int getPipelineCompleted() {
+	int completed = pipeline.completed[STAGE_COUNTER], stage;
+	
+	for (stage = STAGE_EQUATION; stage < PIPELINE_STAGES; stage++) {
+		completed = pipeline.completed[stage] < completed ? pipeline.completed[stage] : completed;
+	}
+	
+	return completed;
+}
+
+/* Body of a stage thread on "-pipeline". Waits for setup to be done with each iteration (setup waits for a free slot
+ * in the pipeline instead), runs the threads of the stage for it, and records what the stage measured. Every stage
+ * only touches the globals of its own phase, so stages of the same or of different iterations can run at once.
+ */
+void *runPipelineStage(void *pipelineStage) {
+	PipelineStage stage = *(PipelineStage *)pipelineStage;
+	int numberOfJobs = pipeline.numberOfJobs[stage], iteration, i;
+	pthread_t threads[numberOfJobs > 0 ? numberOfJobs : 1];
+	PoolJob *jobs = &pipeline.jobs[pipeline.firstJob[stage]];
+	PipelineIteration *record;
+	pthread_attr_t attr;
+	uint64_t startTime;
+	char *dName;
+	
+	pthread_attr_init(&attr);
+	for (iteration = 0; iteration < pipeline.numberOfIterations; iteration++) {
+		record = &pipeline.iterations[iteration];
+		
+		pthread_mutex_lock(&pipeline.mtx);
+		if (stage == STAGE_SETUP) {
+			while (iteration - getPipelineCompleted() >= pipeline.depth) {
+				pthread_cond_wait(&pipeline.condProgress, &pipeline.mtx);
+			}
+		} else {
+			while (pipeline.completed[STAGE_SETUP] <= iteration) {
+				pthread_cond_wait(&pipeline.condProgress, &pipeline.mtx);
+			}
+		}
+		pthread_mutex_unlock(&pipeline.mtx);
+		
+		if (stage == STAGE_SETUP) {
+			record->startTime = getTimeNanoseconds();
+			dName = malloc(sizeof(dirName) + 4);
+			sprintf((char *)dName, dirName, iteration);
+			mkdir((char *)dName, S_IRWXU | S_IRGRP | S_IROTH);
+			free(dName);
+		} else {
+			if (stage == STAGE_COUNTER) {
+				resetCounterPhase();
+			} else if (stage == STAGE_EQUATION) {
+				resetEquationPhase();
+			} else {
+				timeTracker.fileStartTime = 0;
+				timeTracker.fileReadElapsedTime = 0;
+				timeTracker.fileWriteElapsedTime = 0;
+				dirNumber = iteration;
+			}
+			
+			startTime = getTimeNanoseconds();
+			for (i = 0; i < numberOfJobs; i++) {
+				setThreadPlacement(&attr, pipeline.firstJob[stage] + i);
+				pthread_create(&threads[i], &attr, runJob, (void *)&jobs[i]);
+			}
+			record->threadTime[stage] = getTimeNanoseconds() - startTime;
+			for (i = 0; i < numberOfJobs; i++) {
+				pthread_join(threads[i], NULL);
+			}
+			record->teardownTime[stage] = getTeardownTime(jobs, numberOfJobs);
+			
+			if (stage == STAGE_COUNTER) {
+				checkCounter(iteration, pipeline.expectedCounter);
+				record->counter = counter;
+				record->casFailures = atomic_load(&casFailures);
+				record->counterTime = timeTracker.counterElapsedTime;
+			} else if (stage == STAGE_EQUATION) {
+				checkEquationSum(iteration, pipeline.equationSlices, pipeline.equationConsumers, pipeline.expectedEquationSum);
+				record->equationTime = timeTracker.equationElapsedTime;
+			} else {
+				record->fileTime = timeTracker.fileElapsedTime;
+				record->fileReadTime = timeTracker.fileReadElapsedTime;
+				record->fileWriteTime = timeTracker.fileWriteElapsedTime;
+			}
+		}
+		
+		pthread_mutex_lock(&pipeline.mtx);
+		pipeline.completed[stage] = iteration + 1;
+		if (stage != STAGE_SETUP && getPipelineCompleted() > iteration) {
+			record->finishTime = getTimeNanoseconds();
+		}
+		pthread_cond_broadcast(&pipeline.condProgress);
+		pthread_mutex_unlock(&pipeline.mtx);
+	}
+	pthread_attr_destroy(&attr);
+	
+	return NULL;
+}
+
+// Puts the measurements of a pipelined iteration where main() reports those of a sequential one
+void loadPipelineIteration(int iteraction) {
+	PipelineIteration *record = &pipeline.iterations[iteraction];
+	
+	timeTracker.iteractionStartTime = record->startTime;
+	timeTracker.threadElapsedTime = record->threadTime[STAGE_COUNTER] + record->threadTime[STAGE_EQUATION] +
+			record->threadTime[STAGE_FILE];
+	timeTracker.threadCreateTime = timeTracker.threadElapsedTime;
+	timeTracker.threadTeardownTime = record->teardownTime[STAGE_COUNTER] + record->teardownTime[STAGE_EQUATION] +
+			record->teardownTime[STAGE_FILE];
+	timeTracker.counterElapsedTime = record->counterTime;
+	timeTracker.equationElapsedTime = record->equationTime;
+	timeTracker.fileElapsedTime = record->fileTime;
+	timeTracker.fileReadElapsedTime = record->fileReadTime;
+	timeTracker.fileWriteElapsedTime = record->fileWriteTime;
+	counter = record->counter;
+	atomic_store(&casFailures, record->casFailures);
+}
+
+/* Increments a counter "increments" times. On mutex mode only one thread can execute it at any given time, under the
+ * lock selected with "-lock"; with "-lock" the time each thread waits for it is recorded.
+ */
+void *incrementCounter(void *counterJob) {
+	if (counterMode == COUNTER_SHARDED) {
+		incrementCounterSharded((CounterJob *)counterJob);
+		return NULL;
+	} else if (counterMode == COUNTER_FETCH_ADD || counterMode == COUNTER_CAS) {
+		incrementCounterAtomic((CounterJob *)counterJob);
+		return NULL;
+	}
+	
+	CounterJob *job = (CounterJob *)counterJob;
+	uint64_t waitStartTime = 0, waitTime;
+	if (measureLock) {
+		waitStartTime = getTimeNanoseconds();
+	}
+	acquireCounterLock(&counterLock, &job->lockHandle);
+	if (measureLock) {
+		waitTime = getTimeNanoseconds() - waitStartTime;
+		job->waitTime += waitTime;
+		recordLatency(&lockLatency, waitTime);
+	}
 
 	if (timeTracker.counterStartTime == 0) {
-		timeTracker.counterStartTime = getTimeMilliseconds(); 
+		timeTracker.counterStartTime = getTimeNanoseconds(); 
 	} 
 
     unsigned long incrementsPerThread;
-	incrementsPerThread = *((unsigned long *)numIncs);
+	incrementsPerThread = job->increments;
 	
 	int increment = 37, decrement = 36;
 	unsigned long i = 0, temp;
@@ -176,99 +1076,400 @@ void *incrementCounter(void *numIncs) {
         i = i + 1;
     } while (i < incrementsPerThread);
 	
-	timeTracker.counterElapsedTime = getTimeMilliseconds() - timeTracker.counterStartTime;
+	timeTracker.counterElapsedTime = getTimeNanoseconds() - timeTracker.counterStartTime;
+	
+	releaseCounterLock(&counterLock, &job->lockHandle);
+	return NULL;
+}
+
+/* Increments the shard owned by the calling thread. Threads run concurrently, "mtxCounter" is only taken to
+ * record when the first thread started and when the last one finished.
+ */
+void incrementCounterSharded(CounterJob *job) {
+	markCounterStart();
+	
+	CounterShard *shard = &counterShards[job->shard];
+	int increment = 37, decrement = 36;
+	unsigned long i = 0, temp;
+    do {
+		temp = shard->value;
+		temp = temp + increment;
+		temp = temp - decrement;
+		shard->value = temp;
+		COUNTER_STEP_BARRIER();
+        i = i + 1;
+    } while (i < job->increments);
+	
+	markCounterFinish();
+}
+
+/* Applies the "+ increment - decrement" step to the shared counter with atomic operations, using the memory order
+ * chosen on the command line. The compare-and-swap variant counts how many times it had to retry.
+ */
+void incrementCounterAtomic(CounterJob *job) {
+	markCounterStart();
+	
+	int increment = 37, decrement = 36;
+	unsigned long i = 0, temp, failures = 0;
+	memory_order loadOrder = counterOrder == memory_order_acq_rel ? memory_order_acquire : counterOrder;
+	
+	if (counterMode == COUNTER_FETCH_ADD) {
+		do {
+			atomic_fetch_add_explicit(&atomicCounter, increment - decrement, counterOrder);
+			i = i + 1;
+		} while (i < job->increments);
+	} else {
+		do {
+			temp = atomic_load_explicit(&atomicCounter, loadOrder);
+			while (!atomic_compare_exchange_weak_explicit(&atomicCounter, &temp, temp + increment - decrement, counterOrder, loadOrder)) {
+				failures++;
+			}
+			i = i + 1;
+		} while (i < job->increments);
+		
+		atomic_fetch_add_explicit(&casFailures, failures, memory_order_relaxed);
+	}
 	
+	markCounterFinish();
+}
+
+// Records the time the first counter thread started. Used by the strategies that do not hold "mtxCounter"
+void markCounterStart() {
+	pthread_mutex_lock(&mtxCounter);
+	if (timeTracker.counterStartTime == 0) {
+		timeTracker.counterStartTime = getTimeNanoseconds(); 
+	} 
 	pthread_mutex_unlock(&mtxCounter);
-	pthread_exit(NULL);
 }
 
-// Reads a file and replicates its contents "numberOfOutputFiles" times inside a directory 
-void *replicateFile(void *directoryNumber) {
-	timeTracker.fileStartTime = getTimeMilliseconds(); 
+// Records the time elapsed since the first counter thread started. The last thread to finish sets the final value
+void markCounterFinish() {
+	pthread_mutex_lock(&mtxCounter);
+	timeTracker.counterElapsedTime = getTimeNanoseconds() - timeTracker.counterStartTime;
+	pthread_mutex_unlock(&mtxCounter);
+}
+
+/* Prints how long the counter threads waited for "counterLock": the latency of every acquisition, the acquisitions per
+ * second of Counter Time, and how evenly the wait was spread across the threads. Fairness is Jain's index of the total
+ * wait of each thread: 1 when every thread waited the same, 1 / N when a single thread did all the waiting.
+ */
+void printLockSummary(CounterJob *jobs, int numberOfJobs, uint64_t counterTime) {
+	double sum = 0, sumOfSquares = 0, wait, minimum = 0, maximum = 0;
+	int i;
+	
+	for (i = 0; i < numberOfJobs; i++) {
+		wait = toMilliseconds(jobs[i].waitTime);
+		sum += wait;
+		sumOfSquares += wait * wait;
+		minimum = i == 0 || wait < minimum ? wait : minimum;
+		maximum = wait > maximum ? wait : maximum;
+	}
+	
+	printf("Lock %s: %llu acquisitions, %.0f acquisitions/sec of Counter Time\n", getLockKindName(counterLockKind),
+			(unsigned long long)lockLatency.count, counterTime > 0 ? lockLatency.count * (double)NANOSECONDS_PER_SECOND / counterTime : 0);
+	printHistogramSummary("Lock acquisition latency", &lockLatency);
+	printf("Lock %s: wait per thread min %.6f, mean %.6f, max %.6f, Jain fairness %.4f\n", getLockKindName(counterLockKind),
+			minimum, sum / numberOfJobs, maximum, sumOfSquares > 0 ? sum * sum / (numberOfJobs * sumOfSquares) : 1);
+}
+
+// Adds up all the shards. Only called after every counter thread has completed
+unsigned long reduceCounterShards() {
+	unsigned long total = 0;
+	int i;
+	
+	for (i = 0; i < numberOfCounterThreads; i++) {
+		total += counterShards[i].value;
+	}
+	
+	return total;
+}
+
+/* Reads a file and replicates its contents inside a directory, once for each output file of its slice. With several
+ * file writers, File Time goes from the first writer start to the last writer finish.
+ */
+void *replicateFile(void *fileSlice) {
+	pthread_mutex_lock(&mtxFileTime);
+	if (timeTracker.fileStartTime == 0) {
+		timeTracker.fileStartTime = getTimeNanoseconds(); 
+	}
+	CopyBackend backend = copyBackend;
+	pthread_mutex_unlock(&mtxFileTime);
 	
 	char *outFile;
 	FILE *inFileHandle, *outFileHandle;
     size_t readSize, fileSize;
+	uint64_t readStartTime, writeStartTime, readElapsedTime = 0, writeElapsedTime = 0;
 	int dirNumber;
+	FileSlice *slice = (FileSlice *)fileSlice;
 
-    dirNumber = *((int *)directoryNumber);
+    dirNumber = *(slice->directoryNumber);
 
+    // In-kernel backends copy without going through a user space buffer. A fallback is kept for the next iterations
+	if (backend != COPY_STDIO) {
+		backend = replicateFileWithBackend(backend, inFileName, outFileName, dirNumber, slice->firstFile, slice->numberOfFiles);
+		
+		pthread_mutex_lock(&mtxFileTime);
+		copyBackend = backend;
+		timeTracker.fileElapsedTime = getTimeNanoseconds() - timeTracker.fileStartTime;
+		pthread_mutex_unlock(&mtxFileTime);
+		return NULL;
+	}
+	
+    // Writes every output straight from the input loaded at startup
+	if (sourceFile.data != NULL) {
+		writeStartTime = getTimeNanoseconds();
+		replicateFileFromSource(&sourceFile, outFileName, dirNumber, slice->firstFile, slice->numberOfFiles);
+		pthread_mutex_lock(&mtxFileTime);
+		timeTracker.fileWriteElapsedTime += getTimeNanoseconds() - writeStartTime;
+		timeTracker.fileElapsedTime = getTimeNanoseconds() - timeTracker.fileStartTime;
+		pthread_mutex_unlock(&mtxFileTime);
+		return NULL;
+	}
+	
+    readStartTime = getTimeNanoseconds();
     inFileHandle = fopen(inFileName, "r");
     fseek(inFileHandle, 0, SEEK_END);
     fileSize = ftell(inFileHandle);
     rewind(inFileHandle);
+    readElapsedTime += getTimeNanoseconds() - readStartTime;
 
-    char *buffer = (char *)malloc(fileSize);
+    char *buffer = (char *)allocateLocalBuffer(fileSize);
 
 	int i;
-	for (i = 0; i < numberOfOutputFiles; i++) {
+	for (i = slice->firstFile; i < slice->firstFile + slice->numberOfFiles; i++) {
 		outFile = (char *)malloc(sizeof(outFileName) + 20);
 		sprintf((char *)outFile, outFileName, dirNumber, i);
+		writeStartTime = getTimeNanoseconds();
 		outFileHandle = fopen(outFile, "w");
+		writeElapsedTime += getTimeNanoseconds() - writeStartTime;
+		yieldCoroutine();
 		while (1) {
+            readStartTime = getTimeNanoseconds();
             readSize = fread(buffer, 1, fileSize, inFileHandle);
+            readElapsedTime += getTimeNanoseconds() - readStartTime;
+			yieldCoroutine();
 
 			if (readSize > 0) {
+				writeStartTime = getTimeNanoseconds();
 				fwrite(buffer, 1, fileSize, outFileHandle);
+				writeElapsedTime += getTimeNanoseconds() - writeStartTime;
+				yieldCoroutine();
 			} else {
 				break;
 			}
 		}
 
+		writeStartTime = getTimeNanoseconds();
 		fclose(outFileHandle);
+		writeElapsedTime += getTimeNanoseconds() - writeStartTime;
+		yieldCoroutine();
 		free(outFile);
 		outFile = NULL;
+        readStartTime = getTimeNanoseconds();
         rewind(inFileHandle);
+        readElapsedTime += getTimeNanoseconds() - readStartTime;
 	}
 
 	fclose(inFileHandle);
-    free(buffer);
+    releaseLocalBuffer(buffer, fileSize);
 	
-	timeTracker.fileElapsedTime = getTimeMilliseconds() - timeTracker.fileStartTime;
+	pthread_mutex_lock(&mtxFileTime);
+	timeTracker.fileReadElapsedTime += readElapsedTime;
+	timeTracker.fileWriteElapsedTime += writeElapsedTime;
+	timeTracker.fileElapsedTime = getTimeNanoseconds() - timeTracker.fileStartTime;
+	pthread_mutex_unlock(&mtxFileTime);
 	
-	pthread_exit(NULL);
+	return NULL;
 }
 
-// Consumes the result of the calculation of the equation. 
+/* Consumes the result of the calculation of the equation. On "-latency" the handoff latencies are recorded in a
+ * histogram private to this thread, and merged into "handoffLatency" once the iteration is over.
+ */
 void *consumeEquationResults() {
-	timeTracker.equationStartTime = getTimeMilliseconds(); 
+	timeTracker.equationStartTime = getTimeNanoseconds(); 
+	
+	LatencyHistogram *latency = NULL;
+	if (measureLatency) {
+		latency = (LatencyHistogram *)malloc(sizeof(LatencyHistogram));
+		resetHistogram(latency);
+	}
 	
 	int i;
-	for (i = 0; i < cord.qtdPointsToCalculate; i++) {
-		getEquationResult();
-	}	
+	if (handoffMode == HANDOFF_RING) {
+		for (i = 0; i < cord.qtdPointsToCalculate; i++) {
+			getEquationResultRing(latency);
+		}
+	} else if (handoffMode == HANDOFF_COROUTINE) {
+		for (i = 0; i < cord.qtdPointsToCalculate; i++) {
+			getEquationResultCoroutine(latency);
+		}
+	} else if (handoffMode == HANDOFF_FUTEX) {
+		for (i = 0; i < cord.qtdPointsToCalculate; i++) {
+			getEquationResultFutex(latency);
+		}
+	} else if (handoffMode == HANDOFF_BATCH) {
+		for (i = 0; i < cord.qtdPointsToCalculate; i++) {
+			getEquationResultBatch(latency);
+		}
+	} else {
+		for (i = 0; i < cord.qtdPointsToCalculate; i++) {
+			getEquationResult(latency);
+		}
+	}
 	
-	timeTracker.equationElapsedTime = getTimeMilliseconds() - timeTracker.equationStartTime;
+	timeTracker.equationElapsedTime = getTimeNanoseconds() - timeTracker.equationStartTime;
 	
-	pthread_exit(NULL);
+	if (latency != NULL) {
+		pthread_mutex_lock(&mtxEquationTime);
+		mergeHistogram(&handoffLatency, latency);
+		pthread_mutex_unlock(&mtxEquationTime);
+		free(latency);
+	}
+	
+	return NULL;
 }
 
 // Produces/calculates the results of the equation
 void *produceEquationResults() {
 	int i;
 	
-	for (i = 0; i < cord.qtdPointsToCalculate; i++) {
-		calculateEquation(i);
+	if (equationKernel != KERNEL_SCALAR) {
+		produceEquationBatches();
+	} else if (handoffMode == HANDOFF_RING) {
+		for (i = 0; i < cord.qtdPointsToCalculate; i++) {
+			calculateEquationRing(i);
+		}
+	} else if (handoffMode == HANDOFF_COROUTINE) {
+		for (i = 0; i < cord.qtdPointsToCalculate; i++) {
+			calculateEquationCoroutine(i);
+		}
+	} else if (handoffMode == HANDOFF_FUTEX) {
+		for (i = 0; i < cord.qtdPointsToCalculate; i++) {
+			calculateEquationFutex(i);
+		}
+	} else if (handoffMode == HANDOFF_BATCH) {
+		for (i = 0; i < cord.qtdPointsToCalculate; i++) {
+			calculateEquationBatch(i);
+		}
+		flushEquationBatch();
+	} else {
+		for (i = 0; i < cord.qtdPointsToCalculate; i++) {
+			calculateEquation(i);
+		}
 	}
 
-	pthread_exit(NULL);
+	return NULL;
 }
 
-/* Function called from inside the equation consumer thread. If the result is not ready to be consumed, than
- * waits until receives a notification that the calculation is ready.
+/* Body of a pooled thread. Waits for a new generation to be dispatched, runs its job, and reports completion.
+ * Loops until the pool is shut down.
  */
-void getEquationResult() {
+void *poolWorker(void *job) {
+	PoolJob *poolJob = (PoolJob *)job;
+	unsigned long lastGeneration = 0;
+	
+	pthread_mutex_lock(&pool.mtx);
+	while (1) {
+		while (pool.generation == lastGeneration && !pool.shutdown) {
+			pthread_cond_wait(&pool.condDispatch, &pool.mtx);
+		}
+		
+		if (pool.shutdown) {
+			break;
+		}
+		
+		lastGeneration = pool.generation;
+		pthread_mutex_unlock(&pool.mtx);
+		
+		runJob(poolJob);
+		
+		pthread_mutex_lock(&pool.mtx);
+		pool.pending--;
+		if (pool.pending == 0) {
+			pthread_cond_signal(&pool.condComplete);
+		}
+	}
+	pthread_mutex_unlock(&pool.mtx);
+	
+	return NULL;
+}
+
+/* Runs a job on the calling thread. On "-perf" the job is measured by a counter group of its own, added to the
+ * counters of its phase.
+ */
+void *runJob(void *job) {
+	PoolJob *poolJob = (PoolJob *)job;
+	void *result = runMeasured(poolJob->routine, poolJob->argument, measurePerf ? poolJob->perf : NULL);
+	
+	poolJob->finishTime = getTimeNanoseconds();
+	return result;
+}
+
+/* Shuts the pool down and joins its "numberOfThreads" threads. Returns the time it took, from the moment the threads
+ * were told to exit, which is the moment their work was over.
+ */
+uint64_t shutdownPool(pthread_t *threads, int numberOfThreads) {
+	uint64_t startTime = getTimeNanoseconds();
+	int i;
+	
+	pthread_mutex_lock(&pool.mtx);
+	pool.shutdown = 1;
+	pthread_cond_broadcast(&pool.condDispatch);
+	pthread_mutex_unlock(&pool.mtx);
+	for (i = 0; i < numberOfThreads; i++) {
+		pthread_join(threads[i], NULL);
+	}
+	
+	return getTimeNanoseconds() - startTime;
+}
+
+/* Time from the moment the last of "numberOfJobs" jobs returned to now. Called once their threads are joined, it is
+ * the teardown of those threads, measured from the same point as on shutdownPool().
+ */
+uint64_t getTeardownTime(PoolJob *jobs, int numberOfJobs) {
+	uint64_t lastFinishTime = 0, currentTime = getTimeNanoseconds();
+	int i;
+	
+	for (i = 0; i < numberOfJobs; i++) {
+		lastFinishTime = jobs[i].finishTime > lastFinishTime ? jobs[i].finishTime : lastFinishTime;
+	}
+	
+	return currentTime > lastFinishTime ? currentTime - lastFinishTime : 0;
+}
+
+// Starts a new generation of work on the pool
+void dispatchPool(int numberOfJobs) {
+	pthread_mutex_lock(&pool.mtx);
+	pool.pending = numberOfJobs;
+	pool.generation++;
+	pthread_cond_broadcast(&pool.condDispatch);
+	pthread_mutex_unlock(&pool.mtx);
+}
+
+// Waits until every pooled thread has completed the current generation
+void waitPool() {
+	pthread_mutex_lock(&pool.mtx);
+	while (pool.pending > 0) {
+		pthread_cond_wait(&pool.condComplete, &pool.mtx);
+	}
+	pthread_mutex_unlock(&pool.mtx);
+}
+
+/* Function called from inside the equation consumer thread. If the result is not ready to be consumed, than
+ * waits until receives a notification that the calculation is ready.
+ */
+void getEquationResult(LatencyHistogram *latency) {
 	pthread_mutex_lock(&mtxCondition);
 
 	while (equationCalculated != 1) {
 		pthread_cond_wait(&condEquation, &mtxCondition);		
 	}
 	
-    double x, y, z;
-    
-    x = cord.x;
-    y = cord.y;
-    z = cord.z;
+	if (latency != NULL) {
+		recordLatency(latency, getTimeNanoseconds() - cord.publishTime);
+	}
+	
+	CONSUME_COORDINATE(&cord);
 
     equationCalculated = 0;
 	
@@ -289,20 +1490,1075 @@ void calculateEquation(int i) {
 	cord.z = exp(cos(sqrt(pow(cord.x, 2) + pow(cord.y, 2))));
 	cord.x += i / 1.1;
 	cord.y += i * 1.1;
+	if (measureLatency) {
+		cord.publishTime = getTimeNanoseconds();
+	}
 
 	equationCalculated = 1;
 	pthread_cond_signal(&condEquation);
 	pthread_mutex_unlock(&mtxCondition);	
 }
 
-double getTimeMilliseconds() {
-	struct timeval tv;
-	struct timezone tz;
+/* Ring counterpart of getEquationResult(). Spins (yielding the processor) while the ring is empty, then takes the
+ * oldest coordinate.
+ */
+void getEquationResultRing(LatencyHistogram *latency) {
+	unsigned long head = atomic_load_explicit(&ring.head, memory_order_relaxed);
+	
+	while (head == ring.cachedTail) {
+		ring.cachedTail = atomic_load_explicit(&ring.tail, memory_order_acquire);
+		if (head == ring.cachedTail) {
+			sched_yield();
+		}
+	}
+	
+	if (latency != NULL) {
+		recordLatency(latency, getTimeNanoseconds() - ring.slots[head & ring.mask].publishTime);
+	}
+	
+	CONSUME_COORDINATE(&ring.slots[head & ring.mask]);
+
+	atomic_store_explicit(&ring.head, head + 1, memory_order_release);
+}
+
+// Ring counterpart of calculateEquation(). The producer owns "cord" and publishes a copy of it on the ring
+
+void calculateEquationRing(int i) {
+	cord.z = exp(cos(sqrt(pow(cord.x, 2) + pow(cord.y, 2))));
+	cord.x += i / 1.1;
+	cord.y += i * 1.1;
+	
+	publishEquationResultRing(&cord);
+}
+
+// Places a coordinate on the ring. Spins (yielding the processor) while the ring is full
+void publishEquationResultRing(EquationCoordinate *point) {
+	unsigned long tail = atomic_load_explicit(&ring.tail, memory_order_relaxed);
+	
+	while (tail - ring.cachedHead == ring.capacity) {
+		ring.cachedHead = atomic_load_explicit(&ring.head, memory_order_acquire);
+		if (tail - ring.cachedHead == ring.capacity) {
+			sched_yield();
+		}
+	}
+	
+	ring.slots[tail & ring.mask] = *point;
+	if (measureLatency) {
+		ring.slots[tail & ring.mask].publishTime = getTimeNanoseconds();
+	}
+	atomic_store_explicit(&ring.tail, tail + 1, memory_order_release);
+}
+
+/* Coroutine counterpart of getEquationResult(). The producer is a generator on the same executor, so waiting for the
+ * next coordinate is yielding to it.
+ */
+void getEquationResultCoroutine(LatencyHistogram *latency) {
+	while (equationCalculated != 1) {
+		yieldCoroutine();
+	}
+	
+	if (latency != NULL) {
+		recordLatency(latency, getTimeNanoseconds() - cord.publishTime);
+	}
+	
+	CONSUME_COORDINATE(&cord);
+
+    equationCalculated = 0;
+}
+
+// Coroutine counterpart of calculateEquation(). Yields until the consumer has taken the previous coordinate
+void calculateEquationCoroutine(int i) {
+	while (equationCalculated == 1) {
+		yieldCoroutine();
+	}
+	
+	cord.z = exp(cos(sqrt(pow(cord.x, 2) + pow(cord.y, 2))));
+	cord.x += i / 1.1;
+	cord.y += i * 1.1;
+	if (measureLatency) {
+		cord.publishTime = getTimeNanoseconds();
+	}
+
+	equationCalculated = 1;
+}
+
+// Coroutine counterpart of publishEquationResult(), used by the vector kernels
+void publishEquationResultCoroutine(EquationCoordinate *point) {
+	while (equationCalculated == 1) {
+		yieldCoroutine();
+	}
+	
+	cord.x = point->x;
+	cord.y = point->y;
+	cord.z = point->z;
+	if (measureLatency) {
+		cord.publishTime = getTimeNanoseconds();
+	}
+
+	equationCalculated = 1;
+}
+
+// Futex counterpart of getEquationResult()
+void getEquationResultFutex(LatencyHistogram *latency) {
+	waitFutexHandoff(&equationHandoff, FUTEX_SLOT_FULL);
+	
+	if (latency != NULL) {
+		recordLatency(latency, getTimeNanoseconds() - cord.publishTime);
+	}
+	
+	CONSUME_COORDINATE(&cord);
+
+	setFutexHandoff(&equationHandoff, FUTEX_SLOT_EMPTY);
+}
+
+// Futex counterpart of calculateEquation()
+void calculateEquationFutex(int i) {
+	waitFutexHandoff(&equationHandoff, FUTEX_SLOT_EMPTY);
+	
+	cord.z = exp(cos(sqrt(pow(cord.x, 2) + pow(cord.y, 2))));
+	cord.x += i / 1.1;
+	cord.y += i * 1.1;
+	if (measureLatency) {
+		cord.publishTime = getTimeNanoseconds();
+	}
+
+	setFutexHandoff(&equationHandoff, FUTEX_SLOT_FULL);
+}
+
+// Futex counterpart of publishEquationResult(), used by the vector kernels
+void publishEquationResultFutex(EquationCoordinate *point) {
+	waitFutexHandoff(&equationHandoff, FUTEX_SLOT_EMPTY);
+	
+	cord.x = point->x;
+	cord.y = point->y;
+	cord.z = point->z;
+	if (measureLatency) {
+		cord.publishTime = getTimeNanoseconds();
+	}
+
+	setFutexHandoff(&equationHandoff, FUTEX_SLOT_FULL);
+}
+
+/* Batch counterpart of getEquationResult(). Waits for a whole block only before its first coordinate, and hands the
+ * block back to the producer after its last one.
+ */
+void getEquationResultBatch(LatencyHistogram *latency) {
+	CoordinateBlocks *b = &coordinateBlocks;
+	EquationCoordinate *point;
+	
+	if (b->consumerIndex == 0) {
+		pthread_mutex_lock(&mtxCondition);
+		while (b->counts[b->consumerBlock] == 0) {
+			pthread_cond_wait(&condEquation, &mtxCondition);
+		}
+		pthread_mutex_unlock(&mtxCondition);
+	}
+	
+	point = &b->blocks[b->consumerBlock][b->consumerIndex++];
+	if (latency != NULL) {
+		recordLatency(latency, getTimeNanoseconds() - point->publishTime);
+	}
+	
+	CONSUME_COORDINATE(point);
+	
+	if (b->consumerIndex == b->counts[b->consumerBlock]) {
+		pthread_mutex_lock(&mtxCondition);
+		b->counts[b->consumerBlock] = 0;
+		pthread_cond_signal(&condEquation);
+		pthread_mutex_unlock(&mtxCondition);
+		b->consumerBlock ^= 1;
+		b->consumerIndex = 0;
+	}
+}
 
-    gettimeofday(&tv, &tz);
-    double milliseconds = tv.tv_sec * 1000 + (double)tv.tv_usec / 1000.0f;
+// Batch counterpart of calculateEquation(). The producer owns "cord" and appends a copy of it to the current block
+void calculateEquationBatch(int i) {
+	cord.z = exp(cos(sqrt(pow(cord.x, 2) + pow(cord.y, 2))));
+	cord.x += i / 1.1;
+	cord.y += i * 1.1;
+	
+	publishEquationResultBatch(&cord);
+}
 
-//    printf("seconds: %ld, microseconds: %d, milliseconds: %.3f\n", tv.tv_sec, tv.tv_usec, milliseconds);
+/* Appends a coordinate to the block being filled. Before the first coordinate of a block waits for the consumer to
+ * have drained it; a full block is handed over right away.
+ */
+void publishEquationResultBatch(EquationCoordinate *point) {
+	CoordinateBlocks *b = &coordinateBlocks;
+	EquationCoordinate *slot;
+	
+	if (b->producerCount == 0) {
+		pthread_mutex_lock(&mtxCondition);
+		while (b->counts[b->producerBlock] != 0) {
+			pthread_cond_wait(&condEquation, &mtxCondition);
+		}
+		pthread_mutex_unlock(&mtxCondition);
+	}
+	
+	slot = &b->blocks[b->producerBlock][b->producerCount++];
+	*slot = *point;
+	if (measureLatency) {
+		slot->publishTime = getTimeNanoseconds();
+	}
+	
+	if (b->producerCount == b->size) {
+		flushEquationBatch();
+	}
+}
 
-    return milliseconds;
+// Hands the block being filled to the consumer, even if it is not full. Does nothing if the block is empty
+void flushEquationBatch() {
+	CoordinateBlocks *b = &coordinateBlocks;
+	
+	if (b->producerCount == 0) {
+		return;
+	}
+	
+	pthread_mutex_lock(&mtxCondition);
+	b->counts[b->producerBlock] = b->producerCount;
+	pthread_cond_signal(&condEquation);
+	pthread_mutex_unlock(&mtxCondition);
+	b->producerBlock ^= 1;
+	b->producerCount = 0;
+}
+
+/* Vector counterpart of calculateEquation(). Evaluates the equation EQUATION_BATCH_SIZE points at a time with the
+ * selected kernel, then hands the points one by one to the consumer through the selected handoff. The consumer
+ * receives exactly what calculateEquation() would have left in "cord": the advanced x and y, and z of the point.
+ */
+void produceEquationBatches() {
+	EquationBatch batch;
+	EquationCoordinate point;
+	double x = cord.x, y = cord.y;
+	int i, j, count;
+	
+	for (i = 0; i < cord.qtdPointsToCalculate; i += count) {
+		count = cord.qtdPointsToCalculate - i < EQUATION_BATCH_SIZE ? cord.qtdPointsToCalculate - i : EQUATION_BATCH_SIZE;
+		computeEquationBatch(evaluateEquation, &batch, x, y, i, count);
+		
+		for (j = 0; j < count; j++) {
+			point.x = batch.x[j + 1];
+			point.y = batch.y[j + 1];
+			point.z = batch.z[j];
+			
+			if (handoffMode == HANDOFF_RING) {
+				publishEquationResultRing(&point);
+			} else if (handoffMode == HANDOFF_COROUTINE) {
+				publishEquationResultCoroutine(&point);
+			} else if (handoffMode == HANDOFF_FUTEX) {
+				publishEquationResultFutex(&point);
+			} else if (handoffMode == HANDOFF_BATCH) {
+				publishEquationResultBatch(&point);
+			} else {
+				publishEquationResult(&point);
+			}
+		}
+		
+		x = batch.x[count];
+		y = batch.y[count];
+	}
+	
+	if (handoffMode == HANDOFF_BATCH) {
+		flushEquationBatch();
+	}
+}
+
+/* Body of a thread on parallel equation mode. Evaluates its slice of points starting from closed form coordinates,
+ * so that no thread depends on the points of another. Equation Time goes from the first start to the last finish.
+ */
+void *evaluateEquationSlice(void *equationSlice) {
+	EquationSlice *slice = (EquationSlice *)equationSlice;
+	
+	pthread_mutex_lock(&mtxEquationTime);
+	if (timeTracker.equationStartTime == 0) {
+		timeTracker.equationStartTime = getTimeNanoseconds();
+	}
+	pthread_mutex_unlock(&mtxEquationTime);
+	
+	slice->sum = evaluateEquationRange(evaluateEquation, slice->firstPoint, slice->count);
+	
+	pthread_mutex_lock(&mtxEquationTime);
+	timeTracker.equationElapsedTime = getTimeNanoseconds() - timeTracker.equationStartTime;
+	pthread_mutex_unlock(&mtxEquationTime);
+	
+	return NULL;
+}
+
+/* Body of a producer on MPMC mode. Evaluates its slice of points from closed form coordinates, as on parallel
+ * equation mode, and enqueues every point. Equation Time starts with the first producer.
+ */
+void *produceEquationQueue(void *equationSlice) {
+	EquationSlice *slice = (EquationSlice *)equationSlice;
+	EquationBatch batch;
+	QueueItem item;
+	long i;
+	int j, size;
+	
+	pthread_mutex_lock(&mtxEquationTime);
+	if (timeTracker.equationStartTime == 0) {
+		timeTracker.equationStartTime = getTimeNanoseconds();
+	}
+	pthread_mutex_unlock(&mtxEquationTime);
+	
+	for (i = 0; i < slice->count; i += size) {
+		size = slice->count - i < EQUATION_BATCH_SIZE ? slice->count - i : EQUATION_BATCH_SIZE;
+		computeEquationBatchClosedForm(evaluateEquation, &batch, slice->firstPoint + i, size);
+		
+		for (j = 0; j < size; j++) {
+			item.x = batch.x[j];
+			item.y = batch.y[j];
+			item.z = batch.z[j];
+			if (measureLatency) {
+				item.publishTime = getTimeNanoseconds();
+			}
+			enqueueMpmc(&equationQueue, &item);
+		}
+	}
+	
+	return NULL;
+}
+
+/* Body of a consumer on MPMC mode. Claims points one at a time until all "queuedPoints" are claimed, and takes one
+ * item from the queue for every point it claimed, so the consumers stop without any end marker on the queue.
+ * Equation Time ends with the last consumer.
+ */
+void *consumeEquationQueue(void *equationConsumer) {
+	EquationConsumer *consumer = (EquationConsumer *)equationConsumer;
+	QueueItem item;
+	
+	LatencyHistogram *latency = NULL;
+	if (measureLatency) {
+		latency = (LatencyHistogram *)malloc(sizeof(LatencyHistogram));
+		resetHistogram(latency);
+	}
+	
+	consumer->points = 0;
+	consumer->sum = 0;
+	while (atomic_fetch_add(&claimedPoints, 1) < queuedPoints) {
+		dequeueMpmc(&equationQueue, &item);
+		if (latency != NULL) {
+			recordLatency(latency, getTimeNanoseconds() - item.publishTime);
+		}
+		consumer->sum += item.z;
+		consumer->points++;
+	}
+	
+	pthread_mutex_lock(&mtxEquationTime);
+	timeTracker.equationElapsedTime = getTimeNanoseconds() - timeTracker.equationStartTime;
+	if (latency != NULL) {
+		mergeHistogram(&handoffLatency, latency);
+	}
+	pthread_mutex_unlock(&mtxEquationTime);
+	free(latency);
+	
+	return NULL;
+}
+
+/* How evenly the consumers shared the points of the run. "minimum" and "maximum" are the points of the least and
+ * most busy consumers over an even share; the result is Jain's index of the points of every consumer.
+ */
+double getConsumerBalance(EquationConsumer *consumers, int numberOfConsumers, double *minimum, double *maximum) {
+	double sum = 0, sumOfSquares = 0, points;
+	int i;
+	
+	*minimum = 0;
+	*maximum = 0;
+	for (i = 0; i < numberOfConsumers; i++) {
+		points = consumers[i].totalPoints;
+		sum += points;
+		sumOfSquares += points * points;
+		*minimum = i == 0 || points < *minimum ? points : *minimum;
+		*maximum = points > *maximum ? points : *maximum;
+	}
+	
+	if (sum == 0) {
+		return 1;
+	}
+	*minimum /= sum / numberOfConsumers;
+	*maximum /= sum / numberOfConsumers;
+	
+	return sum * sum / (numberOfConsumers * sumOfSquares);
+}
+
+/* Runs every combination of 1, 2, 4, ... up to "maximumThreads" producers and consumers on both queues, and reports
+ * the points per second of each grid cell and how evenly its consumers shared the points. Runs before the experiment,
+ * so handoff latencies are not recorded.
+ */
+void runMpmcGrid(int maximumThreads) {
+	QueueKind kind;
+	uint64_t elapsedTime;
+	double sum, expectedSum, minimumShare, maximumShare, fairness;
+	int latency = measureLatency;
+	int producers, consumers, i;
+	FILE *fp;
+	
+	fp = fopen(MpmcGridFileName, "w");
+	fprintf(fp, "Queue, Producers, Consumers, Points, Equation Time, Points per Second, Min Share, Max Share, Fairness\n");
+	
+	expectedSum = evaluateEquationSequence(evaluateEquation, numberOfEquationPoints);
+	queuedPoints = numberOfEquationPoints;
+	measureLatency = 0;
+	for (kind = QUEUE_LOCK; kind <= QUEUE_VYUKOV; kind++) {
+		initMpmcQueue(&equationQueue, kind, ringCapacity);
+		
+		for (producers = 1; ; producers = producers * 2 < maximumThreads ? producers * 2 : maximumThreads) {
+			for (consumers = 1; ; consumers = consumers * 2 < maximumThreads ? consumers * 2 : maximumThreads) {
+				pthread_t threads[producers + consumers];
+				EquationSlice slices[producers];
+				EquationConsumer consumerJobs[consumers];
+				
+				splitEquationPoints(slices, producers, numberOfEquationPoints);
+				resetMpmcQueue(&equationQueue);
+				atomic_store(&claimedPoints, 0);
+				timeTracker.equationStartTime = 0;
+				
+				for (i = 0; i < consumers; i++) {
+					pthread_create(&threads[producers + i], NULL, consumeEquationQueue, (void *)&consumerJobs[i]);
+				}
+				for (i = 0; i < producers; i++) {
+					pthread_create(&threads[i], NULL, produceEquationQueue, (void *)&slices[i]);
+				}
+				for (i = 0; i < producers + consumers; i++) {
+					pthread_join(threads[i], NULL);
+				}
+				elapsedTime = timeTracker.equationElapsedTime;
+				
+				sum = 0;
+				for (i = 0; i < consumers; i++) {
+					sum += consumerJobs[i].sum;
+					consumerJobs[i].totalPoints = consumerJobs[i].points;
+				}
+				if (fabs(sum - expectedSum) > getEquationSequenceTolerance(numberOfEquationPoints) * fabs(expectedSum)) {
+					fprintf(stderr, "%s %dx%d: equation sum is %.9f, expected %.9f\n", getQueueKindName(kind), producers, consumers,
+							sum, expectedSum);
+				}
+				fairness = getConsumerBalance(consumerJobs, consumers, &minimumShare, &maximumShare);
+				
+				fprintf(fp, "%s, %d, %d, %d, %.3f, %.0f, %.3f, %.3f, %.4f\n", getQueueKindName(kind), producers, consumers,
+						numberOfEquationPoints, toMilliseconds(elapsedTime), numberOfEquationPoints * (double)NANOSECONDS_PER_SECOND / elapsedTime,
+						minimumShare, maximumShare, fairness);
+				#if SCREENING == 1 
+					printf("MPMC grid: %s %d producers x %d consumers -> %.3f, %.0f points/sec, share min %.3f max %.3f, fairness %.4f\n",
+						   getQueueKindName(kind), producers, consumers, toMilliseconds(elapsedTime),
+						   numberOfEquationPoints * (double)NANOSECONDS_PER_SECOND / elapsedTime, minimumShare, maximumShare, fairness);
+				#endif
+				
+				if (consumers >= maximumThreads) {
+					break;
+				}
+			}
+			if (producers >= maximumThreads) {
+				break;
+			}
+		}
+		
+		destroyMpmcQueue(&equationQueue);
+	}
+	
+	fclose(fp);
+	measureLatency = latency;
+	timeTracker.equationStartTime = 0;
+}
+
+/* Writer of the snapshot benchmark. Walks the points of the equation as calculateEquation() does and publishes every
+ * coordinate to the selected cell without waiting for any reader to see it.
+ */
+void *writeSnapshots() {
+	double x = 0, y = 0, z;
+	unsigned sequence;
+	int i;
+	
+	for (i = 0; i < numberOfEquationPoints; i++) {
+		z = exp(cos(sqrt(pow(x, 2) + pow(y, 2))));
+		x += i / 1.1;
+		y += i * 1.1;
+		
+		if (snapshotCell == SNAPSHOT_SEQLOCK) {
+			sequence = atomic_load_explicit(&seqlockCord.sequence, memory_order_relaxed);
+			atomic_store_explicit(&seqlockCord.sequence, sequence + 1, memory_order_relaxed);
+			atomic_thread_fence(memory_order_release);
+			atomic_store_explicit(&seqlockCord.x, x, memory_order_relaxed);
+			atomic_store_explicit(&seqlockCord.y, y, memory_order_relaxed);
+			atomic_store_explicit(&seqlockCord.z, z, memory_order_relaxed);
+			atomic_store_explicit(&seqlockCord.sequence, sequence + 2, memory_order_release);
+		} else {
+			pthread_mutex_lock(&mtxCondition);
+			cord.x = x;
+			cord.y = y;
+			cord.z = z;
+			pthread_mutex_unlock(&mtxCondition);
+		}
+	}
+	
+	atomic_store(&snapshotWriterDone, 1);
+	
+	return NULL;
+}
+
+/* Reader of the snapshot benchmark. Copies the coordinate until the writer is done. Every point of the writer has
+ * y = 1.21 x, so a snapshot mixing two points is caught by checking the ratio. z belongs to the point before x and y,
+ * so it cannot be checked against them without redoing the equation; it is only copied.
+ */
+void *readSnapshots(void *snapshotReader) {
+	SnapshotReader *reader = (SnapshotReader *)snapshotReader;
+	EquationCoordinate snapshot;
+	unsigned before, after;
+	
+	while (!atomic_load_explicit(&snapshotWriterDone, memory_order_relaxed)) {
+		if (snapshotCell == SNAPSHOT_SEQLOCK) {
+			for (;;) {
+				before = atomic_load_explicit(&seqlockCord.sequence, memory_order_acquire);
+				snapshot.x = atomic_load_explicit(&seqlockCord.x, memory_order_relaxed);
+				snapshot.y = atomic_load_explicit(&seqlockCord.y, memory_order_relaxed);
+				snapshot.z = atomic_load_explicit(&seqlockCord.z, memory_order_relaxed);
+				atomic_thread_fence(memory_order_acquire);
+				after = atomic_load_explicit(&seqlockCord.sequence, memory_order_relaxed);
+				if (before == after && (before & 1) == 0) {
+					break;
+				}
+				// The writer is in the middle of a store; on a busy machine it may be waiting for this processor
+				reader->retries++;
+				sched_yield();
+			}
+		} else {
+			pthread_mutex_lock(&mtxCondition);
+			snapshot.x = cord.x;
+			snapshot.y = cord.y;
+			snapshot.z = cord.z;
+			pthread_mutex_unlock(&mtxCondition);
+		}
+		
+		if (fabs(snapshot.y - 1.21 * snapshot.x) > EQUATION_RANGE_TOLERANCE * fabs(snapshot.y)) {
+			reader->inconsistent++;
+		}
+		CONSUME_COORDINATE(&snapshot);
+		reader->reads++;
+	}
+	
+	return NULL;
+}
+
+/* Runs one writer against 1, 2, 4, ... up to "maximumReaders" snapshot readers, on the mutex and on the seqlock cell,
+ * and reports the snapshots read per second, the share of seqlock copies that had to be retried, and the time the
+ * writer took to publish "numberOfEquationPoints" coordinates.
+ */
+void runSnapshotReaders(int maximumReaders) {
+	uint64_t startTime, elapsedTime, writeTime;
+	unsigned long reads, retries, inconsistent;
+	int numberOfReaders, i;
+	FILE *fp;
+	
+	fp = fopen(SnapshotFileName, "w");
+	fprintf(fp, "Cell, Readers, Writes, Reads, Reads per Second, Retry Rate, Write Time\n");
+	
+	for (snapshotCell = SNAPSHOT_MUTEX; snapshotCell <= SNAPSHOT_SEQLOCK; snapshotCell++) {
+		for (numberOfReaders = 1; ; numberOfReaders = numberOfReaders * 2 < maximumReaders ? numberOfReaders * 2 : maximumReaders) {
+			pthread_t threads[numberOfReaders + 1];
+			SnapshotReader readers[numberOfReaders];
+			
+			memset(readers, 0, sizeof(readers));
+			atomic_store(&seqlockCord.sequence, 0);
+			atomic_store(&seqlockCord.x, 0);
+			atomic_store(&seqlockCord.y, 0);
+			atomic_store(&seqlockCord.z, 1);
+			cord.x = 0;
+			cord.y = 0;
+			cord.z = 1;
+			atomic_store(&snapshotWriterDone, 0);
+			
+			startTime = getTimeNanoseconds();
+			for (i = 0; i < numberOfReaders; i++) {
+				pthread_create(&threads[i + 1], NULL, readSnapshots, (void *)&readers[i]);
+			}
+			pthread_create(&threads[0], NULL, writeSnapshots, NULL);
+			pthread_join(threads[0], NULL);
+			writeTime = getTimeNanoseconds() - startTime;
+			for (i = 0; i < numberOfReaders; i++) {
+				pthread_join(threads[i + 1], NULL);
+			}
+			elapsedTime = getTimeNanoseconds() - startTime;
+			
+			reads = 0;
+			retries = 0;
+			inconsistent = 0;
+			for (i = 0; i < numberOfReaders; i++) {
+				reads += readers[i].reads;
+				retries += readers[i].retries;
+				inconsistent += readers[i].inconsistent;
+			}
+			if (inconsistent > 0) {
+				fprintf(stderr, "Snapshot %s, %d readers: %lu inconsistent snapshots\n", SnapshotCellNames[snapshotCell], numberOfReaders,
+						inconsistent);
+			}
+			
+			fprintf(fp, "%s, %d, %d, %lu, %.0f, %.6f, %.3f\n", SnapshotCellNames[snapshotCell], numberOfReaders, numberOfEquationPoints,
+					reads, reads * (double)NANOSECONDS_PER_SECOND / elapsedTime, reads + retries > 0 ? (double)retries / (reads + retries) : 0,
+					toMilliseconds(writeTime));
+			#if SCREENING == 1 
+				printf("Snapshot %s: 1 writer, %d readers -> %.0f reads/sec, retry rate %.6f, write time %.3f\n",
+					   SnapshotCellNames[snapshotCell], numberOfReaders, reads * (double)NANOSECONDS_PER_SECOND / elapsedTime,
+					   reads + retries > 0 ? (double)retries / (reads + retries) : 0, toMilliseconds(writeTime));
+			#endif
+			
+			if (numberOfReaders >= maximumReaders) {
+				break;
+			}
+		}
+	}
+	
+	fclose(fp);
+}
+
+// Divides the points in contiguous slices whose sizes differ by at most one point
+void splitEquationPoints(EquationSlice *slices, int numberOfSlices, long numberOfPoints) {
+	long firstPoint = 0;
+	int i;
+	
+	for (i = 0; i < numberOfSlices; i++) {
+		slices[i].firstPoint = firstPoint;
+		slices[i].count = numberOfPoints / numberOfSlices + (i < numberOfPoints % numberOfSlices ? 1 : 0);
+		slices[i].sum = 0;
+		firstPoint += slices[i].count;
+	}
+}
+
+double sumEquationSlices(EquationSlice *slices, int numberOfSlices) {
+	double sum = 0;
+	int i;
+	
+	for (i = 0; i < numberOfSlices; i++) {
+		sum += slices[i].sum;
+	}
+	
+	return sum;
+}
+
+/* Evaluates "numberOfPoints" points on parallel equation mode with 1, 2, 4, ... threads, up to the number of online
+ * processors, and reports the speedup and parallel efficiency of each thread count over the single thread run.
+ */
+void runEquationScaling(long numberOfPoints) {
+	long numberOfProcessors = sysconf(_SC_NPROCESSORS_ONLN);
+	uint64_t startTime, elapsedTime, singleThreadTime = 0;
+	double sum, singleThreadSum = 0;
+	int numberOfThreads, i;
+	FILE *fp;
+	
+	fp = fopen(ScalingFileName, "w");
+	fprintf(fp, "Threads, Points, Equation Time, Speedup, Efficiency\n");
+	
+	for (numberOfThreads = 1; ; numberOfThreads = numberOfThreads * 2 < numberOfProcessors ? numberOfThreads * 2 : numberOfProcessors) {
+		pthread_t threads[numberOfThreads];
+		EquationSlice slices[numberOfThreads];
+		
+		splitEquationPoints(slices, numberOfThreads, numberOfPoints);
+		timeTracker.equationStartTime = 0;
+		
+		startTime = getTimeNanoseconds();
+		for (i = 0; i < numberOfThreads; i++) {
+			pthread_create(&threads[i], NULL, evaluateEquationSlice, (void *)&slices[i]);
+		}
+		for (i = 0; i < numberOfThreads; i++) {
+			pthread_join(threads[i], NULL);
+		}
+		elapsedTime = getTimeNanoseconds() - startTime;
+		
+		sum = sumEquationSlices(slices, numberOfThreads);
+		if (numberOfThreads == 1) {
+			singleThreadTime = elapsedTime;
+			singleThreadSum = sum;
+		} else if (fabs(sum - singleThreadSum) > EQUATION_RANGE_TOLERANCE * fabs(singleThreadSum)) {
+			fprintf(stderr, "%d threads: equation sum is %.9f, expected %.9f\n", numberOfThreads, sum, singleThreadSum);
+		}
+		
+		fprintf(fp, "%d, %ld, %.3f, %.3f, %.3f\n", numberOfThreads, numberOfPoints, toMilliseconds(elapsedTime), (double)singleThreadTime / elapsedTime,
+				(double)singleThreadTime / elapsedTime / numberOfThreads);
+		#if SCREENING == 1 
+			printf("Equation scaling: %d threads -> %.3f, speedup %.3f, efficiency %.3f\n", numberOfThreads, toMilliseconds(elapsedTime),
+                   (double)singleThreadTime / elapsedTime, (double)singleThreadTime / elapsedTime / numberOfThreads);
+		#endif
+		
+		if (numberOfThreads >= numberOfProcessors) {
+			break;
+		}
+	}
+	
+	fclose(fp);
+	timeTracker.equationStartTime = 0;
+}
+
+/* Hands "numberOfEquationPoints" coordinates from the producer to the consumer in blocks of 1, 2, 4, ... up to
+ * "maximumSize" coordinates, and reports the Equation Time of each block size and its speedup over single coordinate
+ * blocks. Runs before the experiment, so handoff latencies are not recorded.
+ */
+void runBatchScaling(int maximumSize) {
+	HandoffMode mode = handoffMode;
+	int latency = measureLatency;
+	uint64_t elapsedTime, singleCoordinateTime = 0;
+	pthread_t threads[2];
+	int size;
+	FILE *fp;
+	
+	fp = fopen(BatchScalingFileName, "w");
+	fprintf(fp, "Batch, Points, Equation Time, Time per Point, Speedup\n");
+	
+	handoffMode = HANDOFF_BATCH;
+	measureLatency = 0;
+	for (size = 1; ; size = size * 2 < maximumSize ? size * 2 : maximumSize) {
+		initBatch(size);
+		cord.x = 0;
+		cord.y = cord.x;
+		
+		pthread_create(&threads[0], NULL, consumeEquationResults, NULL);
+		pthread_create(&threads[1], NULL, produceEquationResults, NULL);
+		pthread_join(threads[0], NULL);
+		pthread_join(threads[1], NULL);
+		
+		elapsedTime = timeTracker.equationElapsedTime;
+		if (size == 1) {
+			singleCoordinateTime = elapsedTime;
+		}
+		
+		fprintf(fp, "%d, %d, %.3f, %.1f, %.3f\n", size, cord.qtdPointsToCalculate, toMilliseconds(elapsedTime),
+				(double)elapsedTime / cord.qtdPointsToCalculate, (double)singleCoordinateTime / elapsedTime);
+		#if SCREENING == 1 
+			printf("Batch scaling: %d coordinates -> %.3f, %.1f ns per point, speedup %.3f\n", size, toMilliseconds(elapsedTime),
+                   (double)elapsedTime / cord.qtdPointsToCalculate, (double)singleCoordinateTime / elapsedTime);
+		#endif
+		
+		if (size >= maximumSize) {
+			break;
+		}
+	}
+	
+	fclose(fp);
+	handoffMode = mode;
+	measureLatency = latency;
+	timeTracker.equationStartTime = 0;
+}
+
+// Divides the output files in contiguous slices whose sizes differ by at most one file
+void splitOutputFiles(FileSlice *slices, int numberOfSlices, int *directoryNumber) {
+	int firstFile = 0, i;
+	
+	for (i = 0; i < numberOfSlices; i++) {
+		slices[i].firstFile = firstFile;
+		slices[i].numberOfFiles = numberOfOutputFiles / numberOfSlices + (i < numberOfOutputFiles % numberOfSlices ? 1 : 0);
+		slices[i].directoryNumber = directoryNumber;
+		firstFile += slices[i].numberOfFiles;
+	}
+}
+
+/* Replicates the file with 1, 2, 4, ... writers, up to "maximumWriters", into a scratch directory and reports File
+ * Time and the aggregate MB/s of each writer count, to find where the disk saturates.
+ */
+void runFileScaling(int maximumWriters, size_t fileSize) {
+	int numberOfWriters, scratchDirectory = -1, i;
+	double throughput;
+	char *dName;
+	FILE *fp;
+	
+	dName = malloc(sizeof(dirName) + 4);
+	sprintf((char *)dName, dirName, scratchDirectory);
+	mkdir((char *)dName, S_IRWXU | S_IRGRP | S_IROTH);
+	free(dName);
+	
+	fp = fopen(FileScalingFileName, "w");
+	fprintf(fp, "Writers, Files, File Time, File Throughput\n");
+	
+	for (numberOfWriters = 1; ; numberOfWriters = numberOfWriters * 2 < maximumWriters ? numberOfWriters * 2 : maximumWriters) {
+		pthread_t threads[numberOfWriters];
+		FileSlice slices[numberOfWriters];
+		
+		splitOutputFiles(slices, numberOfWriters, &scratchDirectory);
+		timeTracker.fileStartTime = 0;
+		
+		for (i = 0; i < numberOfWriters; i++) {
+			pthread_create(&threads[i], NULL, replicateFile, (void *)&slices[i]);
+		}
+		for (i = 0; i < numberOfWriters; i++) {
+			pthread_join(threads[i], NULL);
+		}
+		
+		throughput = timeTracker.fileElapsedTime > 0 ?
+				(double)fileSize * numberOfOutputFiles / (1024 * 1024) / (timeTracker.fileElapsedTime / (double)NANOSECONDS_PER_SECOND) : 0;
+		fprintf(fp, "%d, %d, %.3f, %.3f\n", numberOfWriters, numberOfOutputFiles, toMilliseconds(timeTracker.fileElapsedTime), throughput);
+		#if SCREENING == 1 
+			printf("File scaling: %d writers -> %.3f, %.3f MB/s\n", numberOfWriters, toMilliseconds(timeTracker.fileElapsedTime), throughput);
+		#endif
+		
+		if (numberOfWriters >= maximumWriters) {
+			break;
+		}
+	}
+	
+	fclose(fp);
+	timeTracker.fileStartTime = 0;
+}
+
+// Condition variable counterpart of publishEquationResultRing(), used by the vector kernels
+void publishEquationResult(EquationCoordinate *point) {
+	pthread_mutex_lock(&mtxCondition);
+	while (equationCalculated == 1) {
+		pthread_cond_wait(&condEquation, &mtxCondition);		
+	}
+	
+	cord.x = point->x;
+	cord.y = point->y;
+	cord.z = point->z;
+	if (measureLatency) {
+		cord.publishTime = getTimeNanoseconds();
+	}
+
+	equationCalculated = 1;
+	pthread_cond_signal(&condEquation);
+	pthread_mutex_unlock(&mtxCondition);	
+}
+
+// Allocates the ring. The capacity is rounded up to a power of two so that indexes can be masked
+void initRing(unsigned long capacity) {
+	ring.capacity = 1;
+	while (ring.capacity < capacity) {
+		ring.capacity <<= 1;
+	}
+	ring.mask = ring.capacity - 1;
+	ring.slots = (EquationCoordinate *)malloc(ring.capacity * sizeof(EquationCoordinate));
+	resetRing();
+}
+
+// Empties the ring. Only called while the producer and the consumer are idle
+void resetRing() {
+	atomic_store(&ring.head, 0);
+	atomic_store(&ring.tail, 0);
+	ring.cachedHead = 0;
+	ring.cachedTail = 0;
+}
+
+// Allocates both blocks of the double buffer in one piece, replacing any previous ones
+void initBatch(int size) {
+	free(coordinateBlocks.blocks[0]);
+	coordinateBlocks.size = size;
+	coordinateBlocks.blocks[0] = (EquationCoordinate *)malloc(2 * size * sizeof(EquationCoordinate));
+	coordinateBlocks.blocks[1] = coordinateBlocks.blocks[0] + size;
+	resetBatch();
+}
+
+// Empties both blocks. Only called while the producer and the consumer are idle
+void resetBatch() {
+	coordinateBlocks.counts[0] = 0;
+	coordinateBlocks.counts[1] = 0;
+	coordinateBlocks.producerBlock = 0;
+	coordinateBlocks.producerCount = 0;
+	coordinateBlocks.consumerBlock = 0;
+	coordinateBlocks.consumerIndex = 0;
+}
+
+/* Reads the command line options. Returns non-zero if an option is not recognized.
+ *   -pool                   Creates the threads once and reuses them on every iteration
+ *   -handoff condition|ring|futex|batch  Selects how equation results go from the producer to the consumer
+ *   -futex-spin N           Checks of the slot before sleeping with "-handoff futex" (default 100)
+ *   -ring N                 Capacity of the ring of "-handoff ring" and of the MPMC queue (rounded up to a power of two)
+ *   -batch K                Coordinates per block with "-handoff batch" (default 64)
+ *   -batch-scaling N        Before the experiment, hands the coordinates over in blocks of 1, 2, 4, ... N (e.g. 4096)
+ *   -counter mutex|sharded|fetchadd|cas  Selects how the counter threads synchronize
+ *   -order relaxed|acq_rel|seq_cst       Memory order used by "-counter fetchadd" and "-counter cas"
+ *   -lock mutex|adaptive|spin|ttas|ticket|mcs|clh
+ *                                        Lock guarding "-counter mutex"; prints its latency, fairness and throughput
+ *   -kernel scalar|sse|avx2|auto         Selects how the equation is evaluated ("auto" picks the widest supported)
+ *   -equation-threads N                  Replaces the producer and consumer by N threads evaluating disjoint slices
+ *   -equation-scaling N                  Before the experiment, evaluates N points with 1, 2, 4, ... threads
+ *   -producers P, -consumers C           Replaces the producer and consumer by P producers and C consumers sharing a
+ *                                        bounded queue (the other count defaults to 1); prints points/sec and balance
+ *   -queue lock|vyukov                   Queue used by "-producers" and "-consumers" (default lock)
+ *   -mpmc-grid N                         Before the experiment, runs 1, 2, 4, ... N producers by as many consumers
+ *                                        on both queues
+ *   -snapshot-readers N                  Before the experiment, runs 1 writer of the coordinate against 1, 2, 4, ... N
+ *                                        readers of consistent snapshots, with a mutex and with a seqlock
+ *   -copy stdio|ficlone|copy_file_range|sendfile|readwrite|uring  Selects how the file is replicated
+ *   -uring-depth N                       Submissions in flight with "-copy uring"
+ *   -file-writers N                      Splits the output files among N writer threads
+ *   -file-scaling N                      Before the experiment, replicates the file with 1, 2, 4, ... N writers
+ *   -source reread|cache|mmap            Reads the input for every output file, or loads it once at startup
+ *   -clock monotonic|tsc                 Selects the clock behind every time measurement
+ *   -latency                             Records the latency of every equation handoff and prints its percentiles
+ *   -perf                                Adds the hardware counters of every phase (cycles, instructions, misses, ...)
+ *   -warmup N                            Leaves the first N iterations out of the summary (default 5)
+ *   -ci-width X                          Stops once every confidence interval is narrower than X times its mean
+ *   -config FILE                         Reads "name = value" workload settings from FILE
+ *   -replay FILE                         Repeats a run with the settings recorded in its log, Posix.Stress.csv
+ *   -iterations N, -output-files N, -equation-points N, -counter-increments N, -counter-threads N
+ *                                        Workload sizes (default 100, 100, 200000, 100000000, 100)
+ *   -input FILE, -output-root DIRECTORY  File replicated on every iteration (default gpl.txt), and where its copies go
+ *   -affinity none|compact|scatter|node|node:N|LIST
+ *                                        Pins the threads; LIST is a processor list such as "0,2,8-11"
+ *   -pipeline D                          Runs the setup, counter, equation and file stages on a thread each, with up to
+ *                                        D iterations in flight; once setup is done, the other stages of an iteration
+ *                                        run together and overlap those of the next iterations
+ *   -coroutines N                        Runs every job as a coroutine on N executor threads instead of a thread each.
+ *                                        The equation handoff becomes a generator and the file writers yield on every I/O.
+ *                                        Cannot be combined with -pool, -perf or -handoff ring|futex|batch
+ */
+int parseArguments(int argc, char *argv[]) {
+	int i, orderSelected = 0;
+	
+	for (i = 1; i < argc; i++) {
+		if (strcmp(argv[i], "-pool") == 0) {
+			usePool = 1;
+		} else if (strcmp(argv[i], "-coroutines") == 0 && i + 1 < argc && atoi(argv[i + 1]) > 0) {
+			numberOfExecutors = atoi(argv[++i]);
+		} else if (strcmp(argv[i], "-pipeline") == 0 && i + 1 < argc && atoi(argv[i + 1]) > 0) {
+			pipelineDepth = atoi(argv[++i]);
+		} else if (strcmp(argv[i], "-lock") == 0 && i + 1 < argc && parseLockKind(argv[i + 1], &counterLockKind) == 0) {
+			measureLock = 1;
+			i++;
+		} else if (strcmp(argv[i], "-latency") == 0) {
+			measureLatency = 1;
+		} else if (strcmp(argv[i], "-perf") == 0) {
+			measurePerf = 1;
+		} else if (strcmp(argv[i], "-handoff") == 0 && i + 1 < argc && strcmp(argv[i + 1], "condition") == 0) {
+			handoffMode = HANDOFF_CONDITION;
+			i++;
+		} else if (strcmp(argv[i], "-handoff") == 0 && i + 1 < argc && strcmp(argv[i + 1], "futex") == 0) {
+			handoffMode = HANDOFF_FUTEX;
+			i++;
+		} else if (strcmp(argv[i], "-futex-spin") == 0 && i + 1 < argc && atoi(argv[i + 1]) >= 0) {
+			futexSpinLimit = atoi(argv[++i]);
+		} else if (strcmp(argv[i], "-handoff") == 0 && i + 1 < argc && strcmp(argv[i + 1], "ring") == 0) {
+			handoffMode = HANDOFF_RING;
+			i++;
+		} else if (strcmp(argv[i], "-handoff") == 0 && i + 1 < argc && strcmp(argv[i + 1], "batch") == 0) {
+			handoffMode = HANDOFF_BATCH;
+			i++;
+		} else if (strcmp(argv[i], "-batch") == 0 && i + 1 < argc && atoi(argv[i + 1]) > 0) {
+			batchSize = atoi(argv[++i]);
+		} else if (strcmp(argv[i], "-batch-scaling") == 0 && i + 1 < argc && atoi(argv[i + 1]) > 0) {
+			batchScalingSize = atoi(argv[++i]);
+		} else if (strcmp(argv[i], "-counter") == 0 && i + 1 < argc && strcmp(argv[i + 1], "mutex") == 0) {
+			counterMode = COUNTER_MUTEX;
+			i++;
+		} else if (strcmp(argv[i], "-counter") == 0 && i + 1 < argc && strcmp(argv[i + 1], "sharded") == 0) {
+			counterMode = COUNTER_SHARDED;
+			i++;
+		} else if (strcmp(argv[i], "-counter") == 0 && i + 1 < argc && strcmp(argv[i + 1], "fetchadd") == 0) {
+			counterMode = COUNTER_FETCH_ADD;
+			i++;
+		} else if (strcmp(argv[i], "-counter") == 0 && i + 1 < argc && strcmp(argv[i + 1], "cas") == 0) {
+			counterMode = COUNTER_CAS;
+			i++;
+		} else if (strcmp(argv[i], "-order") == 0 && i + 1 < argc && strcmp(argv[i + 1], "relaxed") == 0) {
+			counterOrder = memory_order_relaxed;
+			orderSelected = 1;
+			i++;
+		} else if (strcmp(argv[i], "-order") == 0 && i + 1 < argc && strcmp(argv[i + 1], "acq_rel") == 0) {
+			counterOrder = memory_order_acq_rel;
+			orderSelected = 1;
+			i++;
+		} else if (strcmp(argv[i], "-order") == 0 && i + 1 < argc && strcmp(argv[i + 1], "seq_cst") == 0) {
+			counterOrder = memory_order_seq_cst;
+			orderSelected = 1;
+			i++;
+		} else if (strcmp(argv[i], "-kernel") == 0 && i + 1 < argc && parseEquationKernel(argv[i + 1], &equationKernel) == 0) {
+			i++;
+		} else if (strcmp(argv[i], "-equation-threads") == 0 && i + 1 < argc && atoi(argv[i + 1]) > 0) {
+			numberOfEquationThreads = atoi(argv[++i]);
+		} else if (strcmp(argv[i], "-producers") == 0 && i + 1 < argc && atoi(argv[i + 1]) > 0) {
+			numberOfProducers = atoi(argv[++i]);
+		} else if (strcmp(argv[i], "-consumers") == 0 && i + 1 < argc && atoi(argv[i + 1]) > 0) {
+			numberOfConsumers = atoi(argv[++i]);
+		} else if (strcmp(argv[i], "-queue") == 0 && i + 1 < argc && parseQueueKind(argv[i + 1], &queueKind) == 0) {
+			i++;
+		} else if (strcmp(argv[i], "-mpmc-grid") == 0 && i + 1 < argc && atoi(argv[i + 1]) > 0) {
+			mpmcGridSize = atoi(argv[++i]);
+		} else if (strcmp(argv[i], "-snapshot-readers") == 0 && i + 1 < argc && atoi(argv[i + 1]) > 0) {
+			snapshotReaders = atoi(argv[++i]);
+		} else if (strcmp(argv[i], "-equation-scaling") == 0 && i + 1 < argc && atol(argv[i + 1]) > 0) {
+			equationScalingPoints = atol(argv[++i]);
+		} else if (strcmp(argv[i], "-copy") == 0 && i + 1 < argc && parseCopyBackend(argv[i + 1], &copyBackend) == 0) {
+			i++;
+		} else if (strcmp(argv[i], "-source") == 0 && i + 1 < argc && parseSourceMode(argv[i + 1], &sourceMode) == 0) {
+			i++;
+		} else if (strcmp(argv[i], "-clock") == 0 && i + 1 < argc && parseClockSource(argv[i + 1], &clockSource) == 0) {
+			i++;
+		} else if (strcmp(argv[i], "-warmup") == 0 && i + 1 < argc && atoi(argv[i + 1]) >= 0) {
+			warmupIterations = atoi(argv[++i]);
+		} else if (strcmp(argv[i], "-ci-width") == 0 && i + 1 < argc && atof(argv[i + 1]) > 0) {
+			confidenceWidth = atof(argv[++i]);
+		} else if (strcmp(argv[i], "-affinity") == 0 && i + 1 < argc) {
+			placement = argv[++i];
+		} else if (strcmp(argv[i], "-config") == 0 && i + 1 < argc) {
+			if (loadConfigFile(settings, NUMBER_OF_SETTINGS, argv[++i]) != 0) {
+				return 1;
+			}
+		} else if (strcmp(argv[i], "-replay") == 0 && i + 1 < argc) {
+			if (loadRunLog(settings, NUMBER_OF_SETTINGS, argv[++i]) != 0) {
+				return 1;
+			}
+		} else if (argv[i][0] == '-' && i + 1 < argc && applySetting(settings, NUMBER_OF_SETTINGS, argv[i] + 1, argv[i + 1]) == 0) {
+			i++;
+		} else if (strcmp(argv[i], "-uring-depth") == 0 && i + 1 < argc && atoi(argv[i + 1]) > 0) {
+			setCopyQueueDepth(atoi(argv[++i]));
+		} else if (strcmp(argv[i], "-file-writers") == 0 && i + 1 < argc && atoi(argv[i + 1]) > 0) {
+			numberOfFileWriters = atoi(argv[++i]);
+		} else if (strcmp(argv[i], "-file-scaling") == 0 && i + 1 < argc && atoi(argv[i + 1]) > 0) {
+			fileScalingWriters = atoi(argv[++i]);
+		} else if (strcmp(argv[i], "-ring") == 0 && i + 1 < argc && atol(argv[i + 1]) > 0) {
+			ringCapacity = atol(argv[++i]);
+		} else {
+			fprintf(stderr, "Usage: %s [-pool] [-handoff condition|ring|futex|batch] [-futex-spin N] [-ring N] [-batch K]\n"
+					"       [-batch-scaling N] [-counter mutex|sharded|fetchadd|cas]\n"
+					"       [-order relaxed|acq_rel|seq_cst] [-lock mutex|adaptive|spin|ttas|ticket|mcs|clh] [-kernel scalar|sse|avx2|auto]\n"
+					"       [-equation-threads N] [-equation-scaling N] [-producers P] [-consumers C] [-queue lock|vyukov] [-mpmc-grid N]\n"
+					"       [-snapshot-readers N] [-copy stdio|ficlone|copy_file_range|sendfile|readwrite|uring]\n"
+					"       [-uring-depth N] [-file-writers N] [-file-scaling N] [-source reread|cache|mmap] [-clock monotonic|tsc]\n"
+					"       [-latency] [-perf] [-warmup N] [-ci-width X] [-config FILE] [-replay FILE] [-iterations N] [-output-files N] [-equation-points N]\n"
+					"       [-counter-increments N] [-counter-threads N] [-input FILE] [-output-root DIRECTORY]\n"
+					"       [-affinity none|compact|scatter|node|node:N|LIST] [-coroutines N] [-pipeline D]\n", argv[0]);
+			return 1;
+		}
+	}
+	
+	if (measureLock && counterMode != COUNTER_MUTEX) {
+		fprintf(stderr, "-lock only applies to -counter mutex\n");
+		return 1;
+	}
+	
+	if (orderSelected && counterMode != COUNTER_FETCH_ADD && counterMode != COUNTER_CAS) {
+		fprintf(stderr, "-order only applies to -counter fetchadd and -counter cas\n");
+		return 1;
+	}
+	
+	if (numberOfProducers > 0 || numberOfConsumers > 0) {
+		if (numberOfEquationThreads > 0 || numberOfExecutors > 0) {
+			fprintf(stderr, "-producers and -consumers cannot be combined with -equation-threads or -coroutines\n");
+			return 1;
+		}
+		numberOfProducers = numberOfProducers > 0 ? numberOfProducers : 1;
+		numberOfConsumers = numberOfConsumers > 0 ? numberOfConsumers : 1;
+	}
+	
+	// Pipelined stages create their own threads on every iteration, their phases overlap in time, and every iteration
+	// is run before any is reported
+	if (pipelineDepth > 0 && (usePool || numberOfExecutors > 0 || measurePerf || confidenceWidth > 0)) {
+		fprintf(stderr, "-pipeline cannot be combined with -pool, -coroutines, -perf or -ci-width\n");
+		return 1;
+	}
+	
+	// A coroutine waiting on a condition variable or spinning on the ring would block its whole executor, and the
+	// counters -perf opens follow threads, not the coroutines an executor switches between
+	if (numberOfExecutors > 0) {
+		if (usePool) {
+			fprintf(stderr, "-coroutines and -pool cannot be combined\n");
+			return 1;
+		}
+		if (handoffMode != HANDOFF_CONDITION) {
+			fprintf(stderr, "-coroutines brings its own handoff and cannot be combined with -handoff ring|futex|batch\n");
+			return 1;
+		}
+		if (measurePerf) {
+			fprintf(stderr, "-coroutines and -perf cannot be combined\n");
+			return 1;
+		}
+		handoffMode = HANDOFF_COROUTINE;
+	}
+	
+	return 0;
 }
@@ -0,0 +1,297 @@
+/*
+    psweep.c
+    Copyright (C) 2010 Dalmo Cirne
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/wait.h>
+
+#define SCREENING 1
+#define MAX_ARGUMENTS 128
+#define LINE_SIZE 1024
+
+// A group of pstress workers whose count is swept, and the column of the pstress summary that measures them
+typedef struct {
+	const char *name;
+	const char *workersOption; // pstress option that sets the number of workers
+	const char *sizeOption;    // pstress option that sets the amount of work, scaled with the workers on "-weak"
+	const char *column;        // Column of Posix.Stress.Summary.csv holding the time of the stage
+	const char *modeOption;    // pstress option and value giving the stage a mode that can be measured, if any
+	const char *mode;
+	unsigned long size;
+	int enabled;
+} SweepStage;
+
+SweepStage stages[] = {
+	{"counter", "-counter-threads", "-counter-increments", "Counter Time", "-counter", "sharded", 100000000, 1},
+	{"equation", "-equation-threads", "-equation-points", "Equation Time", NULL, NULL, 200000, 1},
+	{"file", "-file-writers", "-output-files", "File Time", NULL, NULL, 100, 1}
+};
+
+// Global variables
+char *pstressPath = "./pstress";
+int numberIteractions = 10;
+int warmupIterations = 2;
+int maximumWorkers = 0;
+int weakScaling = 0;
+int numberOfExtraArguments = 0;
+char **extraArguments;
+char *const SummaryFileName = "Posix.Stress.Summary.csv";
+char *const FileName = "Posix.Stress.Sweep.csv";
+
+// Prototypes of functions
+int runStage(SweepStage *stage, int numberOfWorkers, double *time);
+int readSummaryMean(const char *column, double *mean);
+void sweepStage(SweepStage *stage, FILE *fp);
+int parseArguments(int argc, char *argv[]);
+
+/* Reruns pstress with 1, 2, 4, ... up to twice the number of processors workers on each stage, and reports the
+ * speedup, the parallel efficiency and the serial fraction of every worker count, plus the serial fraction fitted
+ * over the whole stage.
+ */
+int main(int argc, char *argv[]) {
+	FILE *fp;
+	int i;
+
+	if (parseArguments(argc, argv) != 0) {
+		return 1;
+	}
+	if (maximumWorkers == 0) {
+		maximumWorkers = 2 * sysconf(_SC_NPROCESSORS_ONLN);
+	}
+
+	fp = fopen(FileName, "w");
+	fprintf(fp, "# scaling = %s\n", weakScaling ? "weak" : "strong");
+	fprintf(fp, "Stage, Workers, Time, Speedup, Efficiency, Serial Fraction\n");
+
+	for (i = 0; i < (int)(sizeof(stages) / sizeof(SweepStage)); i++) {
+		if (stages[i].enabled) {
+			sweepStage(&stages[i], fp);
+		}
+	}
+
+	fclose(fp);
+
+	return 0;
+}
+
+/* Sweeps the number of workers of one stage. On strong scaling the amount of work is fixed, the speedup is T1 / TN and
+ * the serial fraction is fitted to Amdahl's law, 1 / S = f + (1 - f) / N. On weak scaling the work grows with the
+ * workers, the speedup is N * T1 / TN and the serial fraction is fitted to Gustafson's law, S = N - f * (N - 1).
+ * Both fits are least squares through the origin over the runs with more than one worker. The equation stage runs
+ * the parallel equation mode, since the producer/consumer handoff always has exactly two threads. The counter stage
+ * runs the sharded counter: the compiler folds the loop of the default mutex counter into a single add, leaving
+ * nothing to measure. Options given after "--" come later on the pstress command line, so they can choose another mode.
+ */
+void sweepStage(SweepStage *stage, FILE *fp) {
+	double time, singleWorkerTime = 0, speedup, serialFraction, x, y, sumXY = 0, sumXX = 0;
+	int numberOfWorkers;
+
+	for (numberOfWorkers = 1; ; numberOfWorkers = numberOfWorkers * 2 < maximumWorkers ? numberOfWorkers * 2 : maximumWorkers) {
+		if (runStage(stage, numberOfWorkers, &time) != 0) {
+			fprintf(stderr, "%s: run with %d workers failed, skipping the rest of the stage\n", stage->name, numberOfWorkers);
+			return;
+		}
+		if (time <= 0) {
+			fprintf(stderr, "%s: run with %d workers was too short to measure, raise %s\n", stage->name, numberOfWorkers,
+					stage->sizeOption);
+			return;
+		}
+
+		if (numberOfWorkers == 1) {
+			singleWorkerTime = time;
+		}
+		speedup = weakScaling ? numberOfWorkers * singleWorkerTime / time : singleWorkerTime / time;
+
+		serialFraction = 0;
+		if (numberOfWorkers > 1) {
+			if (weakScaling) {
+				x = numberOfWorkers - 1;
+				y = numberOfWorkers - speedup;
+			} else {
+				x = 1 - 1.0 / numberOfWorkers;
+				y = 1 / speedup - 1.0 / numberOfWorkers;
+			}
+			serialFraction = y / x;
+			sumXY += x * y;
+			sumXX += x * x;
+		}
+
+		fprintf(fp, "%s, %d, %.3f, %.3f, %.3f, %.6f\n", stage->name, numberOfWorkers, time, speedup, speedup / numberOfWorkers,
+				serialFraction);
+		#if SCREENING == 1
+			printf("%s: %d workers -> %.3f, speedup %.3f, efficiency %.3f, serial fraction %.6f\n", stage->name, numberOfWorkers,
+				   time, speedup, speedup / numberOfWorkers, serialFraction);
+		#endif
+
+		if (numberOfWorkers >= maximumWorkers) {
+			break;
+		}
+	}
+
+	if (sumXX > 0) {
+		serialFraction = sumXY / sumXX;
+		if (weakScaling) {
+			printf("%s: Gustafson serial fraction %.6f\n", stage->name, serialFraction);
+		} else {
+			if (serialFraction > 0) {
+				printf("%s: Amdahl serial fraction %.6f, speedup bound %.1f\n", stage->name, serialFraction, 1 / serialFraction);
+			} else {
+				printf("%s: Amdahl serial fraction %.6f, no speedup bound\n", stage->name, serialFraction);
+			}
+		}
+	}
+}
+
+/* Runs pstress once with "numberOfWorkers" workers on the stage and reads back the mean time of the stage, in
+ * milliseconds. The output of pstress is discarded; its errors are not. Returns non-zero if the run failed.
+ */
+int runStage(SweepStage *stage, int numberOfWorkers, double *time) {
+	char *arguments[MAX_ARGUMENTS];
+	char iterations[32], warmup[32], workers[32], size[32];
+	int numberOfArguments = 0, status, nullFd, i;
+	pid_t pid;
+
+	sprintf(iterations, "%d", numberIteractions);
+	sprintf(warmup, "%d", warmupIterations);
+	sprintf(workers, "%d", numberOfWorkers);
+	sprintf(size, "%lu", weakScaling ? stage->size * numberOfWorkers : stage->size);
+
+	arguments[numberOfArguments++] = pstressPath;
+	if (stage->modeOption != NULL) {
+		arguments[numberOfArguments++] = (char *)stage->modeOption;
+		arguments[numberOfArguments++] = (char *)stage->mode;
+	}
+	for (i = 0; i < numberOfExtraArguments && numberOfArguments < MAX_ARGUMENTS - 9; i++) {
+		arguments[numberOfArguments++] = extraArguments[i];
+	}
+	arguments[numberOfArguments++] = "-iterations";
+	arguments[numberOfArguments++] = iterations;
+	arguments[numberOfArguments++] = "-warmup";
+	arguments[numberOfArguments++] = warmup;
+	arguments[numberOfArguments++] = (char *)stage->workersOption;
+	arguments[numberOfArguments++] = workers;
+	arguments[numberOfArguments++] = (char *)stage->sizeOption;
+	arguments[numberOfArguments++] = size;
+	arguments[numberOfArguments] = NULL;
+
+	pid = fork();
+	if (pid < 0) {
+		perror("fork");
+		return 1;
+	}
+	if (pid == 0) {
+		nullFd = open("/dev/null", O_WRONLY);
+		dup2(nullFd, STDOUT_FILENO);
+		execv(pstressPath, arguments);
+		perror(pstressPath);
+		_exit(127);
+	}
+
+	if (waitpid(pid, &status, 0) < 0 || !WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+		return 1;
+	}
+
+	return readSummaryMean(stage->column, time);
+}
+
+// Reads the mean of a column from the summary pstress writes at the end of a run. Returns non-zero if it is missing
+int readSummaryMean(const char *column, double *mean) {
+	char line[LINE_SIZE];
+	size_t length = strlen(column);
+	FILE *fp;
+	int found = 0;
+
+	fp = fopen(SummaryFileName, "r");
+	if (fp == NULL) {
+		return 1;
+	}
+
+	// Rows look like "Counter Time, <samples>, <mean>, ..."
+	while (!found && fgets(line, sizeof(line), fp) != NULL) {
+		if (strncmp(line, column, length) == 0 && line[length] == ',') {
+			found = sscanf(line + length + 1, " %*d, %lf", mean) == 1;
+		}
+	}
+
+	fclose(fp);
+
+	return found ? 0 : 1;
+}
+
+/* Reads the command line options. Returns non-zero if an option is not recognized.
+ *   -pstress PATH                 pstress binary to run (default ./pstress)
+ *   -iterations N                 Iterations of every pstress run (default 10)
+ *   -warmup N                     Iterations left out of the mean of every run (default 2)
+ *   -max N                        Largest number of workers (default twice the number of processors)
+ *   -stage counter|equation|file  Sweeps only the given stage; repeat to sweep several
+ *   -weak                         Grows the work with the workers (Gustafson) instead of fixing it (Amdahl)
+ *   -counter-increments N, -equation-points N, -output-files N
+ *                                 Work of a single worker run (default 100000000, 200000, 100)
+ *   -- OPTIONS                    Passes the remaining options to every pstress run, e.g. "-- -counter cas -pool"
+ */
+int parseArguments(int argc, char *argv[]) {
+	int i, j, stageSelected = 0;
+
+	for (i = 1; i < argc; i++) {
+		if (strcmp(argv[i], "--") == 0) {
+			extraArguments = &argv[i + 1];
+			numberOfExtraArguments = argc - i - 1;
+			break;
+		} else if (strcmp(argv[i], "-pstress") == 0 && i + 1 < argc) {
+			pstressPath = argv[++i];
+		} else if (strcmp(argv[i], "-iterations") == 0 && i + 1 < argc && atoi(argv[i + 1]) > 0) {
+			numberIteractions = atoi(argv[++i]);
+		} else if (strcmp(argv[i], "-warmup") == 0 && i + 1 < argc && atoi(argv[i + 1]) >= 0) {
+			warmupIterations = atoi(argv[++i]);
+		} else if (strcmp(argv[i], "-max") == 0 && i + 1 < argc && atoi(argv[i + 1]) > 0) {
+			maximumWorkers = atoi(argv[++i]);
+		} else if (strcmp(argv[i], "-weak") == 0) {
+			weakScaling = 1;
+		} else if (strcmp(argv[i], "-stage") == 0 && i + 1 < argc) {
+			if (!stageSelected) {
+				for (j = 0; j < (int)(sizeof(stages) / sizeof(SweepStage)); j++) {
+					stages[j].enabled = 0;
+				}
+				stageSelected = 1;
+			}
+			for (j = 0; j < (int)(sizeof(stages) / sizeof(SweepStage)) && strcmp(argv[i + 1], stages[j].name) != 0; j++);
+			if (j == (int)(sizeof(stages) / sizeof(SweepStage))) {
+				break;
+			}
+			stages[j].enabled = 1;
+			i++;
+		} else {
+			for (j = 0; j < (int)(sizeof(stages) / sizeof(SweepStage)) && strcmp(argv[i], stages[j].sizeOption) != 0; j++);
+			if (j == (int)(sizeof(stages) / sizeof(SweepStage)) || i + 1 >= argc || strtoul(argv[i + 1], NULL, 10) == 0) {
+				break;
+			}
+			stages[j].size = strtoul(argv[++i], NULL, 10);
+		}
+	}
+
+	if (i < argc && numberOfExtraArguments == 0 && strcmp(argv[i], "--") != 0) {
+		fprintf(stderr, "Usage: %s [-pstress PATH] [-iterations N] [-warmup N] [-max N] [-stage counter|equation|file] [-weak]\n"
+				"       [-counter-increments N] [-equation-points N] [-output-files N] [-- pstress options]\n", argv[0]);
+		return 1;
+	}
+
+	return 0;
+}
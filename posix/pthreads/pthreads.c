@@ -18,22 +18,32 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <pthread.h>
 #include <math.h>
 #include <sys/stat.h>
-#include <sys/time.h>
+#include "../common/equation.h"
+#include "../common/filecopy.h"
+#include "../common/timing.h"
+#include "../common/stats.h"
+#include "../common/config.h"
+#include "../common/perfcounters.h"
+#include "../common/affinity.h"
 
-#define outFileName "outfiles%d/gpl.%d.txt"
-#define dirName "outfiles%d"
+#define OUT_FILE_FORMAT "outfiles%d/gpl.%d.txt"
+#define DIR_FORMAT "outfiles%d"
+#define PATH_SIZE 4096
+#define NUMBER_OF_SETTINGS (int)(sizeof(settings) / sizeof(Setting))
 #define SCREENING 1
 
-// Time tracker structure. Holds all time measurements relevant to this experiment.
+// Time tracker structure. Holds all time measurements relevant to this experiment, in nanoseconds.
 typedef struct {
-	double startTime, elapsedTime;
-	double iteractionStartTime, iteractionElapsedTime;
-	double counterStartTime, counterElapsedTime;
-	double equationStartTime, equationElapsedTime;
-	double fileStartTime, fileElapsedTime;
+	uint64_t startTime, elapsedTime;
+	uint64_t iteractionStartTime, iteractionElapsedTime;
+	uint64_t counterStartTime, counterElapsedTime;
+	uint64_t equationStartTime, equationElapsedTime;
+	uint64_t fileStartTime, fileElapsedTime;
+	uint64_t fileReadElapsedTime, fileWriteElapsedTime;
 } TimeTracker;
 
 // Structure containing the equation of 2 variables coordinates (x, y), its result (z) and the number of points to calculate
@@ -46,102 +56,396 @@ EquationCoordinate cord;
 TimeTracker timeTracker;
 
 // Global variables
-const int numberIteractions = 100;
-const int numberOfOutputFiles = 100;
-const int numberOfEquationPoints = 200000;
-const unsigned long numberOfCounterIncrements = 100000000;
-char *const inFileName = "gpl.txt";
+int numberIteractions = 100;
+int numberOfOutputFiles = 100;
+int numberOfEquationPoints = 200000;
+unsigned long numberOfCounterIncrements = 100000000;
+char *inFileName = "gpl.txt";
+char *outputRoot = ".";
+char outFileName[PATH_SIZE], dirName[PATH_SIZE];
+
+// Workload settings, given as "-name value" on the command line or as "name = value" in a "-config" file
+const Setting settings[] = {
+	{"iterations", SETTING_INT, &numberIteractions},
+	{"output-files", SETTING_INT, &numberOfOutputFiles},
+	{"equation-points", SETTING_INT, &numberOfEquationPoints},
+	{"counter-increments", SETTING_ULONG, &numberOfCounterIncrements},
+	{"input", SETTING_STRING, &inFileName},
+	{"output-root", SETTING_STRING, &outputRoot}
+};
 unsigned long counter;
 int dirNumber;
+EquationKernel equationKernel = KERNEL_SCALAR;
+EquationBatchFunction evaluateEquation;
+CopyBackend copyBackend = COPY_STDIO;
+ClockSource clockSource = CLOCK_SOURCE_MONOTONIC;
+char *placement = "none";
+int warmupIterations = 5;
+double confidenceWidth = 0;
+const char *const SummaryColumns[] = {"Counter Time", "Equation Time", "File Time", "Iteration Time"};
+SourceMode sourceMode = SOURCE_REREAD;
+SourceFile sourceFile;
+int measurePerf = 0;
+PerfCounts counterPerf, equationPerf, filePerf;
 char *const FileName = "Posix.Threads.csv";
+char *const SummaryFileName = "Posix.Threads.Summary.csv";
+
+// Thread function of a phase, its argument, and the counters its hardware events go to on "-perf"
+typedef struct {
+	void *(*routine)(void *);
+	void *argument;
+	PerfCounts *perf;
+} PhaseJob;
+
+// Stages of an iteration on "-pipeline". Setup comes first; the other three run at the same time
+typedef enum {
+	STAGE_SETUP,    // Creates the output directory of the iteration, which the file stage needs
+	STAGE_COUNTER,
+	STAGE_EQUATION,
+	STAGE_FILE,
+	PIPELINE_STAGES
+} PipelineStage;
+
+// Measurements of one iteration on "-pipeline", kept until the stages are done with the whole run
+typedef struct {
+	uint64_t startTime, finishTime;
+	uint64_t counterTime, equationTime, fileTime, fileReadTime, fileWriteTime;
+} PipelineIteration;
+
+/* Iterations run as a pipeline. Every stage runs the phase of one iteration after another on a thread of its own,
+ * starting as soon as setup is done with the iteration, so the phases of an iteration overlap each other, as in a
+ * sequential iteration, and those of consecutive iterations overlap too. At most "depth" iterations are in flight:
+ * setup waits until every other stage is done with iteration N - depth.
+ */
+typedef struct {
+	pthread_mutex_t mtx;
+	pthread_cond_t condProgress;
+	int depth, numberOfIterations;
+	int completed[PIPELINE_STAGES]; // Iterations each stage is done with
+	PhaseJob *phaseJobs[PIPELINE_STAGES]; // Phase run by each stage; none for setup
+	PipelineIteration *iterations;
+} Pipeline;
+
+Pipeline pipeline = {
+	.mtx = PTHREAD_MUTEX_INITIALIZER,
+	.condProgress = PTHREAD_COND_INITIALIZER
+};
+int pipelineDepth = 0;
 
 // Prototypes of functions executed by threads
+void *runPhase(void *phaseJob);
+void *runPipelineStage(void *pipelineStage);
+int getPipelineCompleted();
 void *incrementCounter(void *numIncs);
 void *replicateFile(void *directoryNumber);
 void *consumeEquationResults();
 
 // Prototypes of functions using or used by the threads
-double getTimeMilliseconds();
 void getEquationResult();
 void calculateEquation(int i);
+void calculateEquationBatches();
+void runPipeline(PhaseJob *phaseJobs, pthread_attr_t *attr);
+void loadPipelineIteration(int iteraction);
+int parseArguments(int argc, char *argv[]);
 
 /* Executes the experiment 'numberIteractions' times. On each cycle integer, floating point, and I/O operations
  * are performed.
  */
 int main(int argc, char *argv[]) {
-	// Starts counting time
-	timeTracker.startTime = getTimeMilliseconds();
-	
 	// Declaration of variables
 	int numberOfThreads = 3; // 1 - counter; 1 - equation; 1 - file
 	pthread_t threads[numberOfThreads];
 	pthread_attr_t attr;
 	unsigned long incrementsPerThread;
+	PhaseJob phaseJobs[] = {
+		{incrementCounter, (void *)&incrementsPerThread, &counterPerf},
+		{replicateFile, (void *)&dirNumber, &filePerf},
+		{consumeEquationResults, NULL, &equationPerf}
+	};
 	char *dName;
 	FILE *fp;
-	double currentTime;
+	uint64_t currentTime;
 			
+	if (parseArguments(argc, argv) != 0) {
+		return 1;
+	}
+	clockSource = initTiming(clockSource);
+	if (initPlacement(placement) != 0) {
+		fprintf(stderr, "Placement %s is not valid on this machine\n", placement);
+		return 1;
+	}
+	
+	// Output directories and files are created under "outputRoot"
+	buildOutputFormat(outFileName, sizeof(outFileName), outputRoot, OUT_FILE_FORMAT);
+	buildOutputFormat(dirName, sizeof(dirName), outputRoot, DIR_FORMAT);
+	mkdir(outputRoot, S_IRWXU | S_IRGRP | S_IXGRP | S_IROTH | S_IXOTH);
+	
+	if (measurePerf) {
+		measurePerf = initPerfCounters() > 0;
+	}
+	
+	// Starts counting time, once the clock is calibrated
+	timeTracker.startTime = getTimeNanoseconds();
+
 	incrementsPerThread = numberOfCounterIncrements;
 	cord.qtdPointsToCalculate = numberOfEquationPoints;
+	equationKernel = selectEquationKernel(equationKernel, numberOfEquationPoints);
+	evaluateEquation = getEquationBatchFunction(equationKernel);
+	if (copyBackend != COPY_STDIO) {
+		printf("File backend: %s\n", getCopyBackendName(copyBackend));
+	}
+	
+	// The input file can be loaded once and shared by every iteration instead of being read again for every output
+	if (sourceMode != SOURCE_REREAD) {
+		currentTime = getTimeNanoseconds();
+		if (loadSourceFile(inFileName, sourceMode, &sourceFile) != 0) {
+			fprintf(stderr, "Could not load %s, reading it on every iteration\n", inFileName);
+		}
+		printf("Source file loaded once in %.3f\n", toMilliseconds(getTimeNanoseconds() - currentTime));
+	}
 	
 	// Creates file to host the experiment's log	
 	fp = fopen(FileName, "w");
-	fprintf(fp, "Elapsed Time, Iteration Time, Counter Time, Equation Time, File Time\n");
+	writeSettings(fp, settings, NUMBER_OF_SETTINGS);
+	writeCommandLine(fp, argc, argv);
+	fprintf(fp, "# kernel = %s\n", getEquationKernelName(equationKernel));
+	writePlacement(fp, numberOfThreads);
+	#if SCREENING == 1 
+		writePlacement(stdout, numberOfThreads);
+	#endif
+	fprintf(fp, "Elapsed Time, Iteration Time, Counter Time, Equation Time, File Time, File Read Time, File Write Time");
+	if (measurePerf) {
+		writePerfHeader(fp, "Counter");
+		writePerfHeader(fp, "Equation");
+		writePerfHeader(fp, "File");
+	}
+	fprintf(fp, "\n");
 
 	// Initializes thread attributes
 	pthread_attr_init(&attr); 
 	pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_JOINABLE);	
 	
 	// Loops "numberIteractions" times to generate enough statistical data for analysis
+	SampleTable samples;
+	double sampleRow[4];
+	initSampleTable(&samples, SummaryColumns, 4, numberIteractions);
+	if (pipelineDepth > 0) {
+		runPipeline(phaseJobs, &attr);
+	}
+	
 	int iteraction, j;
 	for (iteraction = 0; iteraction < numberIteractions; iteraction++) {
-		timeTracker.iteractionStartTime = getTimeMilliseconds();
-		counter = 0;
+		if (pipelineDepth > 0) {
+			// The stages already ran this iteration; only its measurements are left to report
+			loadPipelineIteration(iteraction);
+		} else {
+			timeTracker.iteractionStartTime = getTimeNanoseconds();
+			counter = 0;
 		
-		cord.x = 0;
-		cord.y = cord.x;
-
-		dName = malloc(sizeof(dirName) + 4);
-		sprintf((char *)dName, dirName, iteraction);
-		mkdir((char *)dName, S_IRWXU | S_IRGRP | S_IROTH);
-		free(dName);
-		dName = NULL;
-		dirNumber = iteraction;
+			cord.x = 0;
+			cord.y = cord.x;
+			resetPerfCounts(&counterPerf);
+			resetPerfCounts(&equationPerf);
+			resetPerfCounts(&filePerf);
+
+			dName = malloc(sizeof(dirName) + 4);
+			sprintf((char *)dName, dirName, iteraction);
+			mkdir((char *)dName, S_IRWXU | S_IRGRP | S_IROTH);
+			free(dName);
+			dName = NULL;
+			dirNumber = iteraction;
 		
-        // Creates all the threads
-        pthread_create(&threads[0], &attr, incrementCounter, (void *)&incrementsPerThread);
-		pthread_create(&threads[1], &attr, replicateFile, (void *)&dirNumber);
-		pthread_create(&threads[2], &attr, consumeEquationResults, NULL);
+                // Creates all the threads
+			setThreadPlacement(&attr, 0);
+			pthread_create(&threads[0], &attr, runPhase, (void *)&phaseJobs[0]);
+			setThreadPlacement(&attr, 1);
+			pthread_create(&threads[1], &attr, runPhase, (void *)&phaseJobs[1]);
+			setThreadPlacement(&attr, 2);
+			pthread_create(&threads[2], &attr, runPhase, (void *)&phaseJobs[2]);
 		
-        // Waits for all threads to complete
-		for (j = 0; j < numberOfThreads; j++) {
-			pthread_join(threads[j], NULL);
+                // Waits for all threads to complete
+			for (j = 0; j < numberOfThreads; j++) {
+				pthread_join(threads[j], NULL);
+			}
 		}
 		
         // Saves result of the current iteration on the log file
-		currentTime = getTimeMilliseconds();
+		currentTime = pipelineDepth > 0 ? pipeline.iterations[iteraction].finishTime : getTimeNanoseconds();
 		timeTracker.iteractionElapsedTime = currentTime - timeTracker.iteractionStartTime;
 		timeTracker.elapsedTime = currentTime - timeTracker.startTime;
-		fprintf(fp, "%.3f, %.3f, %.3f, %.3f, %.3f\n", timeTracker.elapsedTime, timeTracker.iteractionElapsedTime, timeTracker.counterElapsedTime,
-				timeTracker.equationElapsedTime, timeTracker.fileElapsedTime);
+		fprintf(fp, "%.3f, %.3f, %.3f, %.3f, %.3f, %.3f, %.3f", toMilliseconds(timeTracker.elapsedTime),
+				toMilliseconds(timeTracker.iteractionElapsedTime), toMilliseconds(timeTracker.counterElapsedTime),
+				toMilliseconds(timeTracker.equationElapsedTime), toMilliseconds(timeTracker.fileElapsedTime),
+				toMilliseconds(timeTracker.fileReadElapsedTime), toMilliseconds(timeTracker.fileWriteElapsedTime));
+		if (measurePerf) {
+			writePerfValues(fp, &counterPerf);
+			writePerfValues(fp, &equationPerf);
+			writePerfValues(fp, &filePerf);
+		}
+		fprintf(fp, "\n");
 		
         // If running on screening mode, also show the results on the screen
 		#if SCREENING == 1 
-			printf("%d -> %.3f, %.3f, %.3f, %.3f, %.3f\n", iteraction, timeTracker.elapsedTime, timeTracker.iteractionElapsedTime,
-                   timeTracker.counterElapsedTime, timeTracker.equationElapsedTime, timeTracker.fileElapsedTime);
+			printf("%d -> %.3f, %.3f, %.3f, %.3f, %.3f, %.3f, %.3f\n", iteraction, toMilliseconds(timeTracker.elapsedTime),
+                   toMilliseconds(timeTracker.iteractionElapsedTime), toMilliseconds(timeTracker.counterElapsedTime),
+                   toMilliseconds(timeTracker.equationElapsedTime), toMilliseconds(timeTracker.fileElapsedTime),
+                   toMilliseconds(timeTracker.fileReadElapsedTime), toMilliseconds(timeTracker.fileWriteElapsedTime));
 		#endif
+		
+		// Stops once every phase is measured precisely enough, without waiting for the remaining iterations
+		sampleRow[0] = toMilliseconds(timeTracker.counterElapsedTime);
+		sampleRow[1] = toMilliseconds(timeTracker.equationElapsedTime);
+		sampleRow[2] = toMilliseconds(timeTracker.fileElapsedTime);
+		sampleRow[3] = toMilliseconds(timeTracker.iteractionElapsedTime);
+		addSampleRow(&samples, sampleRow);
+		if (pipelineDepth == 0 && confidenceWidth > 0 && isConfidenceReached(&samples, warmupIterations, confidenceWidth)) {
+			printf("Confidence interval within %.3f of the mean after %d iterations, stopping\n", confidenceWidth, iteraction + 1);
+			break;
+		}
 	}
 	
 	fclose(fp); // Closes experiment's log file
+	writeSampleSummary(&samples, warmupIterations, SummaryFileName);
+	freeSampleTable(&samples);
+	releaseSourceFile(&sourceFile);
+	free(pipeline.iterations);
 
     // Frees thread attributes
 	pthread_attr_destroy(&attr);
 	pthread_exit(NULL);
 }
 
+// Runs the thread function of a phase. On "-perf" its hardware counters are read once it returns
+void *runPhase(void *phaseJob) {
+	PhaseJob *job = (PhaseJob *)phaseJob;
+	
+	return runMeasured(job->routine, job->argument, measurePerf ? job->perf : NULL);
+}
+
+/* Runs all the iterations as a pipeline of "pipelineDepth" iterations, one thread per stage, and keeps the measurements
+ * of every iteration for main() to report. Prints the sustained iterations per second next to the mean latency of an
+ * iteration, from the start of its setup to the end of its last stage.
+ */
+void runPipeline(PhaseJob *phaseJobs, pthread_attr_t *attr) {
+	PipelineStage stages[PIPELINE_STAGES];
+	pthread_t threads[PIPELINE_STAGES];
+	uint64_t latency = 0, elapsedTime;
+	int i;
+	
+	pipeline.depth = pipelineDepth;
+	pipeline.numberOfIterations = numberIteractions;
+	pipeline.phaseJobs[STAGE_SETUP] = NULL;
+	pipeline.phaseJobs[STAGE_COUNTER] = &phaseJobs[0];
+	pipeline.phaseJobs[STAGE_FILE] = &phaseJobs[1];
+	pipeline.phaseJobs[STAGE_EQUATION] = &phaseJobs[2];
+	pipeline.iterations = (PipelineIteration *)calloc(numberIteractions, sizeof(PipelineIteration));
+	
+	// Every phase keeps the processor of its thread on the sequential mode; setup goes with the counter
+	for (i = 0; i < PIPELINE_STAGES; i++) {
+		pipeline.completed[i] = 0;
+		stages[i] = (PipelineStage)i;
+		setThreadPlacement(attr, i == STAGE_SETUP || i == STAGE_COUNTER ? 0 : i == STAGE_FILE ? 1 : 2);
+		pthread_create(&threads[i], attr, runPipelineStage, (void *)&stages[i]);
+	}
+	for (i = 0; i < PIPELINE_STAGES; i++) {
+		pthread_join(threads[i], NULL);
+	}
+	
+	for (i = 0; i < numberIteractions; i++) {
+		latency += pipeline.iterations[i].finishTime - pipeline.iterations[i].startTime;
+	}
+	elapsedTime = pipeline.iterations[numberIteractions - 1].finishTime - pipeline.iterations[0].startTime;
+	printf("Pipeline depth %d: %d iterations in %.3f, %.3f iterations/sec, iteration latency mean %.3f\n", pipelineDepth,
+			numberIteractions, toMilliseconds(elapsedTime), numberIteractions * (double)NANOSECONDS_PER_SECOND / elapsedTime,
+			toMilliseconds(latency / numberIteractions));
+}
+
+// Iterations that the counter, equation and file stages are all done with. Only called holding "pipeline.mtx"
+int getPipelineCompleted() {
+	int completed = pipeline.completed[STAGE_COUNTER], stage;
+	
+	for (stage = STAGE_EQUATION; stage < PIPELINE_STAGES; stage++) {
+		completed = pipeline.completed[stage] < completed ? pipeline.completed[stage] : completed;
+	}
+	
+	return completed;
+}
+
+/* Body of a stage thread on "-pipeline". Waits for setup to be done with each iteration (setup waits for a free slot
+ * in the pipeline instead), runs the phase of the stage for it, and records what the phase measured. Every phase only
+ * touches the globals of its own, so stages of the same or of different iterations can run at once.
+ */
+void *runPipelineStage(void *pipelineStage) {
+	PipelineStage stage = *(PipelineStage *)pipelineStage;
+	PipelineIteration *record;
+	int iteration;
+	char *dName;
+	
+	for (iteration = 0; iteration < pipeline.numberOfIterations; iteration++) {
+		record = &pipeline.iterations[iteration];
+		
+		pthread_mutex_lock(&pipeline.mtx);
+		if (stage == STAGE_SETUP) {
+			while (iteration - getPipelineCompleted() >= pipeline.depth) {
+				pthread_cond_wait(&pipeline.condProgress, &pipeline.mtx);
+			}
+		} else {
+			while (pipeline.completed[STAGE_SETUP] <= iteration) {
+				pthread_cond_wait(&pipeline.condProgress, &pipeline.mtx);
+			}
+		}
+		pthread_mutex_unlock(&pipeline.mtx);
+		
+		if (stage == STAGE_SETUP) {
+			record->startTime = getTimeNanoseconds();
+			dName = malloc(sizeof(dirName) + 4);
+			sprintf((char *)dName, dirName, iteration);
+			mkdir((char *)dName, S_IRWXU | S_IRGRP | S_IROTH);
+			free(dName);
+		} else if (stage == STAGE_COUNTER) {
+			counter = 0;
+			runPhase(pipeline.phaseJobs[stage]);
+			record->counterTime = timeTracker.counterElapsedTime;
+		} else if (stage == STAGE_EQUATION) {
+			cord.x = 0;
+			cord.y = cord.x;
+			runPhase(pipeline.phaseJobs[stage]);
+			record->equationTime = timeTracker.equationElapsedTime;
+		} else {
+			dirNumber = iteration;
+			runPhase(pipeline.phaseJobs[stage]);
+			record->fileTime = timeTracker.fileElapsedTime;
+			record->fileReadTime = timeTracker.fileReadElapsedTime;
+			record->fileWriteTime = timeTracker.fileWriteElapsedTime;
+		}
+		
+		pthread_mutex_lock(&pipeline.mtx);
+		pipeline.completed[stage] = iteration + 1;
+		if (stage != STAGE_SETUP && getPipelineCompleted() > iteration) {
+			record->finishTime = getTimeNanoseconds();
+		}
+		pthread_cond_broadcast(&pipeline.condProgress);
+		pthread_mutex_unlock(&pipeline.mtx);
+	}
+	
+	return NULL;
+}
+
+// Puts the measurements of a pipelined iteration where main() reports those of a sequential one
+void loadPipelineIteration(int iteraction) {
+	PipelineIteration *record = &pipeline.iterations[iteraction];
+	
+	timeTracker.iteractionStartTime = record->startTime;
+	timeTracker.counterElapsedTime = record->counterTime;
+	timeTracker.equationElapsedTime = record->equationTime;
+	timeTracker.fileElapsedTime = record->fileTime;
+	timeTracker.fileReadElapsedTime = record->fileReadTime;
+	timeTracker.fileWriteElapsedTime = record->fileWriteTime;
+}
+
 // Increments a counter "numIncs" times. Only one thread can execute it at any given time.
 void *incrementCounter(void *numIncs) {
-	timeTracker.counterStartTime = getTimeMilliseconds(); 
+	timeTracker.counterStartTime = getTimeNanoseconds(); 
 
     unsigned long incrementsPerThread;
 	incrementsPerThread = *((unsigned long *)numIncs);
@@ -156,71 +460,129 @@ void *incrementCounter(void *numIncs) {
         i = i + 1;
     } while (i < incrementsPerThread);
 	
-	timeTracker.counterElapsedTime = getTimeMilliseconds() - timeTracker.counterStartTime;
+	timeTracker.counterElapsedTime = getTimeNanoseconds() - timeTracker.counterStartTime;
 	
-    pthread_exit(NULL);
+    return NULL;
 }
 
 // Reads a file and replicates its contents "numberOfOutputFiles" times inside a directory 
 void *replicateFile(void *directoryNumber) {
-	timeTracker.fileStartTime = getTimeMilliseconds(); 
+	timeTracker.fileStartTime = getTimeNanoseconds(); 
 	
 	char *outFile;
 	FILE *inFileHandle, *outFileHandle;
     size_t readSize, fileSize;
+	uint64_t readStartTime, writeStartTime, readElapsedTime = 0, writeElapsedTime = 0;
 	int dirNumber;
 
     dirNumber = *((int *)directoryNumber);
 	
+    // In-kernel backends copy without going through a user space buffer
+	if (copyBackend != COPY_STDIO) {
+		copyBackend = replicateFileWithBackend(copyBackend, inFileName, outFileName, dirNumber, 0, numberOfOutputFiles);
+		timeTracker.fileReadElapsedTime = 0;
+		timeTracker.fileWriteElapsedTime = 0;
+		timeTracker.fileElapsedTime = getTimeNanoseconds() - timeTracker.fileStartTime;
+		return NULL;
+	}
+	
+    // Writes every output straight from the input loaded at startup
+	if (sourceFile.data != NULL) {
+		writeStartTime = getTimeNanoseconds();
+		replicateFileFromSource(&sourceFile, outFileName, dirNumber, 0, numberOfOutputFiles);
+		timeTracker.fileReadElapsedTime = 0;
+		timeTracker.fileWriteElapsedTime = getTimeNanoseconds() - writeStartTime;
+		timeTracker.fileElapsedTime = getTimeNanoseconds() - timeTracker.fileStartTime;
+		return NULL;
+	}
+	
+    readStartTime = getTimeNanoseconds();
     inFileHandle = fopen(inFileName, "r");
     fseek(inFileHandle, 0, SEEK_END);
     fileSize = ftell(inFileHandle);
     rewind(inFileHandle);
+    readElapsedTime += getTimeNanoseconds() - readStartTime;
 
-    char *buffer = (char *)malloc(fileSize);
+    char *buffer = (char *)allocateLocalBuffer(fileSize);
 
 	int i;
 	for (i = 0; i < numberOfOutputFiles; i++) {
 		outFile = (char *)malloc(sizeof(outFileName) + 20);
 		sprintf((char *)outFile, outFileName, dirNumber, i);
+		writeStartTime = getTimeNanoseconds();
 		outFileHandle = fopen(outFile, "w");
+		writeElapsedTime += getTimeNanoseconds() - writeStartTime;
 		while (1) {
+            readStartTime = getTimeNanoseconds();
             readSize = fread(buffer, 1, fileSize, inFileHandle);
+            readElapsedTime += getTimeNanoseconds() - readStartTime;
 			
 			if (readSize > 0) {
+				writeStartTime = getTimeNanoseconds();
 				fwrite(buffer, 1, fileSize, outFileHandle);
+				writeElapsedTime += getTimeNanoseconds() - writeStartTime;
 			} else {
 				break;
 			}
 		}
 		
+		writeStartTime = getTimeNanoseconds();
 		fclose(outFileHandle);
+		writeElapsedTime += getTimeNanoseconds() - writeStartTime;
 		free(outFile);
 		outFile = NULL;
+        readStartTime = getTimeNanoseconds();
         rewind(inFileHandle);
+        readElapsedTime += getTimeNanoseconds() - readStartTime;
 	}
 	
 	fclose(inFileHandle);
-    free(buffer);
+    releaseLocalBuffer(buffer, fileSize);
 	
-	timeTracker.fileElapsedTime = getTimeMilliseconds() - timeTracker.fileStartTime;
+	timeTracker.fileReadElapsedTime = readElapsedTime;
+	timeTracker.fileWriteElapsedTime = writeElapsedTime;
+	timeTracker.fileElapsedTime = getTimeNanoseconds() - timeTracker.fileStartTime;
 	
-	pthread_exit(NULL);
+	return NULL;
 }
 
 // Consumes the result of the calculation of the equation. 
 void *consumeEquationResults() {
-	timeTracker.equationStartTime = getTimeMilliseconds(); 
+	timeTracker.equationStartTime = getTimeNanoseconds(); 
 	
 	int i;
-	for (i = 0; i < cord.qtdPointsToCalculate; i++) {
-        calculateEquation(i);
-		getEquationResult();
-	}	
+	if (equationKernel != KERNEL_SCALAR) {
+		calculateEquationBatches();
+	} else {
+		for (i = 0; i < cord.qtdPointsToCalculate; i++) {
+			calculateEquation(i);
+			getEquationResult();
+		}
+	}
 	
-	timeTracker.equationElapsedTime = getTimeMilliseconds() - timeTracker.equationStartTime;
+	timeTracker.equationElapsedTime = getTimeNanoseconds() - timeTracker.equationStartTime;
 	
-	pthread_exit(NULL);
+	return NULL;
+}
+
+/* Vector counterpart of calculateEquation(). Evaluates the equation EQUATION_BATCH_SIZE points at a time with the selected
+ * kernel, then hands the points one by one to getEquationResult() exactly as calculateEquation() would have left them in "cord".
+ */
+void calculateEquationBatches() {
+	EquationBatch batch;
+	int i, j, count;
+	
+	for (i = 0; i < cord.qtdPointsToCalculate; i += count) {
+		count = cord.qtdPointsToCalculate - i < EQUATION_BATCH_SIZE ? cord.qtdPointsToCalculate - i : EQUATION_BATCH_SIZE;
+		computeEquationBatch(evaluateEquation, &batch, cord.x, cord.y, i, count);
+		
+		for (j = 0; j < count; j++) {
+			cord.x = batch.x[j + 1];
+			cord.y = batch.y[j + 1];
+			cord.z = batch.z[j];
+			getEquationResult();
+		}
+	}
 }
 
 /* Function called from inside the equation consumer thread. If the result is not ready to be consumed, than
@@ -244,14 +606,74 @@ void calculateEquation(int i) {
 	cord.y += i * 1.1;
 }
 
-double getTimeMilliseconds() {
-	struct timeval tv;
-	struct timezone tz;
-
-    gettimeofday(&tv, &tz);
-    double milliseconds = tv.tv_sec * 1000 + (double)tv.tv_usec / 1000.0f;
-
-//    printf("seconds: %ld, microseconds: %d, milliseconds: %.3f\n", tv.tv_sec, tv.tv_usec, milliseconds);
-
-    return milliseconds;
+/* Reads the command line options. Returns non-zero if an option is not recognized.
+ *   -kernel scalar|sse|avx2|auto                                  Selects how the equation is evaluated ("auto" picks the widest supported)
+ *   -copy stdio|ficlone|copy_file_range|sendfile|readwrite|uring  Selects how the file is replicated
+ *   -uring-depth N                                                Submissions in flight with "-copy uring"
+ *   -source reread|cache|mmap                                     Reads the input for every output file, or loads it once
+ *   -clock monotonic|tsc                                          Selects the clock behind every time measurement
+ *   -warmup N                                                     Leaves the first N iterations out of the summary (default 5)
+ *   -ci-width X                                                   Stops once every confidence interval is narrower than X times its mean
+ *   -perf                                                         Adds the hardware counters of every phase (cycles, instructions, misses, ...)
+ *   -config FILE                                                  Reads "name = value" workload settings from FILE
+ *   -replay FILE                                                  Repeats a run with the settings recorded in its log, Posix.Threads.csv
+ *   -iterations N, -output-files N, -equation-points N, -counter-increments N
+ *                                                                 Workload sizes (default 100, 100, 200000, 100000000)
+ *   -input FILE, -output-root DIRECTORY                           File replicated on every iteration (default gpl.txt), and where its copies go
+ *   -affinity none|compact|scatter|node|node:N|LIST               Pins the threads; LIST is a processor list such as "0,2,8-11"
+ *   -pipeline D                                                   Runs the setup, counter, equation and file stages on a thread
+ *                                                                 each, with up to D iterations in flight; once setup is done, the
+ *                                                                 other stages of an iteration run together and overlap the next ones
+ */
+int parseArguments(int argc, char *argv[]) {
+	int i;
+	
+	for (i = 1; i < argc; i++) {
+		if (strcmp(argv[i], "-kernel") == 0 && i + 1 < argc && parseEquationKernel(argv[i + 1], &equationKernel) == 0) {
+			i++;
+		} else if (strcmp(argv[i], "-copy") == 0 && i + 1 < argc && parseCopyBackend(argv[i + 1], &copyBackend) == 0) {
+			i++;
+		} else if (strcmp(argv[i], "-source") == 0 && i + 1 < argc && parseSourceMode(argv[i + 1], &sourceMode) == 0) {
+			i++;
+		} else if (strcmp(argv[i], "-clock") == 0 && i + 1 < argc && parseClockSource(argv[i + 1], &clockSource) == 0) {
+			i++;
+		} else if (strcmp(argv[i], "-warmup") == 0 && i + 1 < argc && atoi(argv[i + 1]) >= 0) {
+			warmupIterations = atoi(argv[++i]);
+		} else if (strcmp(argv[i], "-ci-width") == 0 && i + 1 < argc && atof(argv[i + 1]) > 0) {
+			confidenceWidth = atof(argv[++i]);
+		} else if (strcmp(argv[i], "-affinity") == 0 && i + 1 < argc) {
+			placement = argv[++i];
+		} else if (strcmp(argv[i], "-perf") == 0) {
+			measurePerf = 1;
+		} else if (strcmp(argv[i], "-pipeline") == 0 && i + 1 < argc && atoi(argv[i + 1]) > 0) {
+			pipelineDepth = atoi(argv[++i]);
+		} else if (strcmp(argv[i], "-config") == 0 && i + 1 < argc) {
+			if (loadConfigFile(settings, NUMBER_OF_SETTINGS, argv[++i]) != 0) {
+				return 1;
+			}
+		} else if (strcmp(argv[i], "-replay") == 0 && i + 1 < argc) {
+			if (loadRunLog(settings, NUMBER_OF_SETTINGS, argv[++i]) != 0) {
+				return 1;
+			}
+		} else if (argv[i][0] == '-' && i + 1 < argc && applySetting(settings, NUMBER_OF_SETTINGS, argv[i] + 1, argv[i + 1]) == 0) {
+			i++;
+		} else if (strcmp(argv[i], "-uring-depth") == 0 && i + 1 < argc && atoi(argv[i + 1]) > 0) {
+			setCopyQueueDepth(atoi(argv[++i]));
+		} else {
+			fprintf(stderr, "Usage: %s [-kernel scalar|sse|avx2|auto] [-copy stdio|ficlone|copy_file_range|sendfile|readwrite|uring]\n"
+					"       [-uring-depth N] [-source reread|cache|mmap] [-clock monotonic|tsc]\n"
+					"       [-perf] [-warmup N] [-ci-width X] [-config FILE] [-replay FILE] [-iterations N] [-output-files N] [-equation-points N]\n"
+					"       [-counter-increments N] [-input FILE] [-output-root DIRECTORY] [-affinity none|compact|scatter|node|node:N|LIST]\n"
+					"       [-pipeline D]\n", argv[0]);
+			return 1;
+		}
+	}
+	
+	// The phases of pipelined iterations overlap in time, and every iteration is run before any is reported
+	if (pipelineDepth > 0 && (measurePerf || confidenceWidth > 0)) {
+		fprintf(stderr, "-pipeline cannot be combined with -perf or -ci-width\n");
+		return 1;
+	}
+	
+	return 0;
 }